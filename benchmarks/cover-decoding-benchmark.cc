@@ -0,0 +1,132 @@
+// Copyright (C) 2009-2011, Romain Goffe <romain.goffe@gmail.com>
+// Copyright (C) 2009-2011, Alexandre Dupas <alexandre.dupas@gmail.com>
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License as
+// published by the Free Software Foundation; either version 2 of the
+// License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+// 02110-1301, USA.
+//******************************************************************************
+
+/**
+ * \file cover-decoding-benchmark.cc
+ *
+ * Compares the decoding of a cover scaled by the JPEG decoder to the
+ * former decoding of the full image followed by a scaling.
+ *
+ * Usage: cover-decoding-benchmark [file.jpg...]
+ *
+ * Without arguments, a generated picture is encoded as a JPEG. Each
+ * cover is decoded a number of times with both methods; the time per
+ * cover and the total size of the images each method decodes for the
+ * largest cover are printed. This is the memory held by the images,
+ * not a measured peak of the process.
+ */
+#include <QCoreApplication>
+#include <QStringList>
+#include <QFile>
+#include <QBuffer>
+#include <QImage>
+#include <QImageReader>
+#include <QPainter>
+#include <QElapsedTimer>
+
+#include <cstdio>
+
+namespace
+{
+  const int Iterations = 20;
+  const QSize ThumbnailSize(128, 128);
+
+  QByteArray sampleCover()
+  {
+    // a gradient keeps the encoder from compressing the picture to
+    // nothing, like the photographs used as covers
+    QImage image(1600, 1600, QImage::Format_RGB32);
+    QPainter painter(&image);
+    QLinearGradient gradient(0, 0, image.width(), image.height());
+    gradient.setColorAt(0, Qt::darkBlue);
+    gradient.setColorAt(0.5, Qt::yellow);
+    gradient.setColorAt(1, Qt::darkRed);
+    painter.fillRect(image.rect(), gradient);
+    painter.end();
+
+    QByteArray data;
+    QBuffer buffer(&data);
+    buffer.open(QIODevice::WriteOnly);
+    image.save(&buffer, "JPEG");
+    return data;
+  }
+
+  /// Decoding of the covers before the thumbnails were scaled by the
+  /// decoder: the full image is allocated, then scaled down.
+  int decodeThenScale(const QByteArray &data)
+  {
+    QImage image;
+    image.loadFromData(data);
+    QImage thumbnail = image.scaled(ThumbnailSize, Qt::KeepAspectRatio, Qt::SmoothTransformation);
+    return image.byteCount() + thumbnail.byteCount();
+  }
+
+  int decodeScaled(const QByteArray &data)
+  {
+    QBuffer buffer;
+    buffer.setData(data);
+    QImageReader reader(&buffer);
+    reader.setScaledSize(reader.size().scaled(ThumbnailSize, Qt::KeepAspectRatio));
+    QImage thumbnail = reader.read();
+    return thumbnail.byteCount();
+  }
+}
+
+int main(int argc, char *argv[])
+{
+  QCoreApplication app(argc, argv);
+
+  QList< QByteArray > covers;
+  QStringList paths = app.arguments().mid(1);
+  foreach (const QString &path, paths)
+    {
+      QFile file(path);
+      if (!file.open(QIODevice::ReadOnly))
+	{
+	  std::fprintf(stderr, "unable to open %s\n", qPrintable(path));
+	  return 1;
+	}
+      covers << file.readAll();
+    }
+  if (covers.isEmpty())
+    covers << sampleCover();
+
+  int fullSize = 0;
+  QElapsedTimer timer;
+  timer.start();
+  for (int i = 0; i < Iterations; ++i)
+    foreach (const QByteArray &cover, covers)
+      fullSize = qMax(fullSize, decodeThenScale(cover));
+  qint64 fullTime = timer.nsecsElapsed();
+
+  int scaledSize = 0;
+  timer.restart();
+  for (int i = 0; i < Iterations; ++i)
+    foreach (const QByteArray &cover, covers)
+      scaledSize = qMax(scaledSize, decodeScaled(cover));
+  qint64 scaledTime = timer.nsecsElapsed();
+
+  int count = Iterations * covers.size();
+  std::printf("covers decoded: %d\n", count);
+  std::printf("decode then scale: %.2f ms/cover, %d KiB of decoded images\n",
+	      fullTime / 1000000.0 / count, fullSize / 1024);
+  std::printf("scaled decoding:   %.2f ms/cover, %d KiB of decoded images\n",
+	      scaledTime / 1000000.0 / count, scaledSize / 1024);
+  return 0;
+}
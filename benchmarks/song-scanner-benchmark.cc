@@ -0,0 +1,129 @@
+// Copyright (C) 2009-2011, Romain Goffe <romain.goffe@gmail.com>
+// Copyright (C) 2009-2011, Alexandre Dupas <alexandre.dupas@gmail.com>
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License as
+// published by the Free Software Foundation; either version 2 of the
+// License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+// 02110-1301, USA.
+//******************************************************************************
+
+/**
+ * \file song-scanner-benchmark.cc
+ *
+ * Compares the single-pass scanner to the former QRegExp parsing of
+ * the song files.
+ *
+ * Usage: song-scanner-benchmark [file.sg...]
+ *
+ * Without arguments, a generated song is parsed. Each file is parsed
+ * a number of times with both methods and the total time is printed.
+ */
+#include <QCoreApplication>
+#include <QStringList>
+#include <QRegExp>
+#include <QFile>
+#include <QElapsedTimer>
+
+#include <cstdio>
+
+#include "song-scanner.hh"
+
+namespace
+{
+  const int Iterations = 1000;
+
+  QByteArray sampleSong()
+  {
+    QByteArray song("\\selectlanguage{english}\n"
+		    "\\beginsong{Sample song}[by={Some artist},album={Some album},cov={cover}]\n"
+		    "\\cover\n");
+    for (int verse = 0; verse < 8; ++verse)
+      {
+	song += "\\beginverse\n";
+	for (int line = 0; line < 6; ++line)
+	  song += "\\[G]Some \\[C]words of the \\[D]song that \\[G]go on and on\n";
+	song += "\\endverse\n";
+      }
+    song += "\\endsong\n";
+    return song;
+  }
+
+  /// Parsing of the library before the scanner was introduced.
+  void parseWithRegExp(const QByteArray &content)
+  {
+    QRegExp reSong("begin\\{?song\\}?\\{([^[\\}]+)\\}[^[]*\\[([^]]*)\\]");
+    QRegExp reArtist("by=([^,]+)");
+    QRegExp reAlbum("album=([^,]+)");
+    QRegExp reCoverName("cov=([^,]+)");
+    QRegExp reLilypond("\\\\lilypond");
+    QRegExp reLanguage("selectlanguage\\{([^\\}]+)");
+
+    QString fileStr = QString::fromUtf8(content);
+    reSong.indexIn(fileStr);
+    reArtist.indexIn(reSong.cap(2));
+    reAlbum.indexIn(reSong.cap(2));
+    reCoverName.indexIn(reSong.cap(2));
+    reLilypond.indexIn(fileStr);
+    reLanguage.indexIn(fileStr);
+  }
+
+  void parseWithScanner(const QByteArray &content)
+  {
+    CSongScanner scanner;
+    scanner.scan(content.constData(), content.size());
+    scanner.title();
+    scanner.artist();
+    scanner.album();
+    scanner.coverName();
+    scanner.language();
+  }
+}
+
+int main(int argc, char *argv[])
+{
+  QCoreApplication app(argc, argv);
+
+  QList< QByteArray > songs;
+  QStringList paths = app.arguments().mid(1);
+  foreach (const QString &path, paths)
+    {
+      QFile file(path);
+      if (!file.open(QIODevice::ReadOnly))
+	{
+	  std::fprintf(stderr, "unable to open %s\n", qPrintable(path));
+	  return 1;
+	}
+      songs << file.readAll();
+    }
+  if (songs.isEmpty())
+    songs << sampleSong();
+
+  QElapsedTimer timer;
+  timer.start();
+  for (int i = 0; i < Iterations; ++i)
+    foreach (const QByteArray &song, songs)
+      parseWithRegExp(song);
+  qint64 regExpTime = timer.nsecsElapsed();
+
+  timer.restart();
+  for (int i = 0; i < Iterations; ++i)
+    foreach (const QByteArray &song, songs)
+      parseWithScanner(song);
+  qint64 scannerTime = timer.nsecsElapsed();
+
+  int count = Iterations * songs.size();
+  std::printf("songs parsed: %d\n", count);
+  std::printf("QRegExp:      %.2f us/song\n", regExpTime / 1000.0 / count);
+  std::printf("CSongScanner: %.2f us/song\n", scannerTime / 1000.0 / count);
+  return 0;
+}
@@ -13,6 +13,7 @@ option(COMPRESS_MANPAGES "compress manpages" ON)
 option(ENABLE_SVG_SUPPORT "allow to use SVG icons fallback" ON)
 option(ENABLE_LIBRARY_DOWNLOAD "allow the application to download songbooks" ON)
 option(ENABLE_SPELL_CHECKING "allow the application to apply spellchecking within song-editor" ON)
+option(BUILD_BENCHMARKS "build the benchmarks of the library" OFF)
 
 # {{{ CFLAGS
 add_definitions(-ggdb3 -fno-strict-aliasing -Wall -Wextra
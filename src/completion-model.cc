@@ -0,0 +1,214 @@
+// Copyright (C) 2009-2011, Romain Goffe <romain.goffe@gmail.com>
+// Copyright (C) 2009-2011, Alexandre Dupas <alexandre.dupas@gmail.com>
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License as
+// published by the Free Software Foundation; either version 2 of the
+// License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+// 02110-1301, USA.
+//******************************************************************************
+#include "completion-model.hh"
+
+#include <QtAlgorithms>
+
+namespace
+{
+  // beyond this number of words, views are reset instead of being
+  // notified of every row
+  const int ResetThreshold = 16;
+}
+
+CCompletionModel::CCompletionModel(QObject *parent)
+  : QAbstractListModel(parent)
+  , m_words()
+  , m_counts()
+{}
+
+CCompletionModel::~CCompletionModel()
+{}
+
+bool CCompletionModel::lessThan(const QString &left, const QString &right)
+{
+  int result = QString::compare(left, right, Qt::CaseInsensitive);
+  if (result == 0)
+    return left < right;
+  return result < 0;
+}
+
+void CCompletionModel::addWords(const QStringList &words)
+{
+  if (words.size() > ResetThreshold)
+    {
+      mergeWords(words);
+      return;
+    }
+
+  foreach (const QString &word, words)
+    {
+      if (word.isEmpty())
+	continue;
+
+      QVector< QString >::iterator it = qLowerBound(m_words.begin(), m_words.end(), word, lessThan);
+      int row = it - m_words.begin();
+      if (it != m_words.end() && *it == word)
+	{
+	  ++m_counts[row];
+	  continue;
+	}
+
+      beginInsertRows(QModelIndex(), row, row);
+      m_words.insert(row, word);
+      m_counts.insert(row, 1);
+      endInsertRows();
+    }
+}
+
+void CCompletionModel::mergeWords(const QStringList &words)
+{
+  // sort the batch once and merge it with the current words in a
+  // single pass rather than inserting in the middle of the vectors
+  QStringList batch(words);
+  qSort(batch.begin(), batch.end(), lessThan);
+
+  QVector< QString > mergedWords;
+  QVector< int > mergedCounts;
+  mergedWords.reserve(m_words.size() + batch.size());
+  mergedCounts.reserve(m_words.size() + batch.size());
+
+  int i = 0;
+  QStringList::const_iterator it = batch.constBegin();
+  while (i < m_words.size() || it != batch.constEnd())
+    {
+      if (it != batch.constEnd() && it->isEmpty())
+	{
+	  ++it;
+	  continue;
+	}
+
+      if (it == batch.constEnd() ||
+	  (i < m_words.size() && lessThan(m_words[i], *it)))
+	{
+	  mergedWords << m_words[i];
+	  mergedCounts << m_counts[i];
+	  ++i;
+	}
+      else if (!mergedWords.isEmpty() && mergedWords.last() == *it)
+	{
+	  ++mergedCounts.last();
+	  ++it;
+	}
+      else if (i < m_words.size() && m_words[i] == *it)
+	{
+	  mergedWords << m_words[i];
+	  mergedCounts << m_counts[i] + 1;
+	  ++i;
+	  ++it;
+	}
+      else
+	{
+	  mergedWords << *it;
+	  mergedCounts << 1;
+	  ++it;
+	}
+    }
+
+  beginResetModel();
+  m_words = mergedWords;
+  m_counts = mergedCounts;
+  endResetModel();
+}
+
+void CCompletionModel::removeWords(const QStringList &words)
+{
+  if (words.size() > ResetThreshold)
+    {
+      subtractWords(words);
+      return;
+    }
+
+  foreach (const QString &word, words)
+    {
+      QVector< QString >::iterator it = qBinaryFind(m_words.begin(), m_words.end(), word, lessThan);
+      if (it == m_words.end())
+	continue;
+
+      int row = it - m_words.begin();
+      if (--m_counts[row] > 0)
+	continue;
+
+      beginRemoveRows(QModelIndex(), row, row);
+      m_words.remove(row);
+      m_counts.remove(row);
+      endRemoveRows();
+    }
+}
+
+void CCompletionModel::subtractWords(const QStringList &words)
+{
+  // like mergeWords(), the remaining words are copied in a single
+  // pass rather than removed from the middle of the vectors
+  QStringList batch(words);
+  qSort(batch.begin(), batch.end(), lessThan);
+
+  QVector< QString > remainingWords;
+  QVector< int > remainingCounts;
+  remainingWords.reserve(m_words.size());
+  remainingCounts.reserve(m_words.size());
+
+  QStringList::const_iterator it = batch.constBegin();
+  for (int i = 0; i < m_words.size(); ++i)
+    {
+      while (it != batch.constEnd() && lessThan(*it, m_words[i]))
+	++it;
+
+      int count = m_counts[i];
+      for (; it != batch.constEnd() && *it == m_words[i]; ++it)
+	--count;
+
+      if (count > 0)
+	{
+	  remainingWords << m_words[i];
+	  remainingCounts << count;
+	}
+    }
+
+  beginResetModel();
+  m_words = remainingWords;
+  m_counts = remainingCounts;
+  endResetModel();
+}
+
+void CCompletionModel::clear()
+{
+  beginResetModel();
+  m_words.clear();
+  m_counts.clear();
+  endResetModel();
+}
+
+int CCompletionModel::rowCount(const QModelIndex &parent) const
+{
+  if (parent.isValid())
+    return 0;
+  return m_words.size();
+}
+
+QVariant CCompletionModel::data(const QModelIndex &index, int role) const
+{
+  if (!index.isValid() || index.row() >= m_words.size())
+    return QVariant();
+
+  if (role == Qt::DisplayRole || role == Qt::EditRole)
+    return m_words[index.row()];
+
+  return QVariant();
+}
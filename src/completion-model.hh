@@ -0,0 +1,69 @@
+// Copyright (C) 2009-2011, Romain Goffe <romain.goffe@gmail.com>
+// Copyright (C) 2009-2011, Alexandre Dupas <alexandre.dupas@gmail.com>
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License as
+// published by the Free Software Foundation; either version 2 of the
+// License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+// 02110-1301, USA.
+//******************************************************************************
+
+/**
+ * \file completion-model.hh
+ *
+ * Completion model of the library filter.
+ *
+ */
+#ifndef __COMPLETION_MODEL_HH__
+#define __COMPLETION_MODEL_HH__
+
+#include <QAbstractListModel>
+#include <QString>
+#include <QStringList>
+#include <QVector>
+
+/**
+ * \class CCompletionModel
+ *
+ * Sorted list of the distinct words proposed for completion.
+ *
+ * Words are kept sorted case insensitively, which lets QCompleter find
+ * a prefix with a binary search. Each word counts its occurrences so
+ * that songs can be added and removed one by one; the strings are
+ * shared with the library rather than copied.
+ */
+class CCompletionModel : public QAbstractListModel
+{
+  Q_OBJECT
+
+public:
+  CCompletionModel(QObject *parent = 0);
+  ~CCompletionModel();
+
+  void addWords(const QStringList &words);
+  void removeWords(const QStringList &words);
+  void clear();
+
+  virtual int rowCount(const QModelIndex &parent = QModelIndex()) const;
+  virtual QVariant data(const QModelIndex &index, int role = Qt::DisplayRole) const;
+
+private:
+  void mergeWords(const QStringList &words);
+  void subtractWords(const QStringList &words);
+
+  static bool lessThan(const QString &left, const QString &right);
+
+  QVector< QString > m_words;
+  QVector< int > m_counts;
+};
+
+#endif // __COMPLETION_MODEL_HH__
@@ -0,0 +1,327 @@
+// Copyright (C) 2009-2011, Romain Goffe <romain.goffe@gmail.com>
+// Copyright (C) 2009-2011, Alexandre Dupas <alexandre.dupas@gmail.com>
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License as
+// published by the Free Software Foundation; either version 2 of the
+// License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+// 02110-1301, USA.
+//******************************************************************************
+#include "cover-loader.hh"
+
+#include <QThreadPool>
+#include <QRunnable>
+#include <QImageReader>
+#include <QMetaObject>
+#include <QDesktopServices>
+#include <QCryptographicHash>
+#include <QFileInfo>
+#include <QDateTime>
+#include <QDir>
+#include <QTemporaryFile>
+#include <QMultiMap>
+
+#include <QDebug>
+
+#if defined(Q_OS_WIN32)
+#include <sys/utime.h>
+#else
+#include <utime.h>
+#endif
+
+namespace
+{
+  // size of the thumbnails kept on disk, in bytes
+  const qint64 MaxDirectorySize = Q_INT64_C(64) * 1024 * 1024;
+
+  // thumbnails being written, and the age beyond which they are
+  // leftovers of an interrupted session, in seconds
+  const char *TemporaryPrefix = "thumbnail-";
+  const int TemporaryLifetime = 3600;
+
+  // the modification time of a thumbnail records when it was last
+  // read, at most once in this number of seconds
+  const int TouchInterval = 24 * 3600;
+}
+
+/// Runnable decoding a cover on a worker thread, the image is handed
+/// back to the loader in the thread it lives in.
+class CCoverLoader::Job : public QRunnable
+{
+public:
+  Job(CCoverLoader *loader, const QString &path, const QSize &size,
+      const QString &cacheDirectory)
+    : m_loader(loader)
+    , m_canceled(&loader->m_canceled)
+    , m_path(path)
+    , m_size(size)
+    , m_cacheDirectory(cacheDirectory)
+  {}
+
+  void run()
+  {
+    // the loader is being destroyed and waits for the queued jobs
+    if (*m_canceled)
+      return;
+
+    QImage image;
+    QFileInfo info(m_path);
+    uint lastModified = info.lastModified().toTime_t();
+    if (info.exists())
+      {
+	QString path = thumbnailPath(m_cacheDirectory, info, m_size);
+	if (image.load(path))
+	  {
+	    touch(path);
+	  }
+	else
+	  {
+	    image = decode(m_path, m_size);
+	    if (!image.isNull())
+	      save(image, path);
+	  }
+      }
+
+    QMetaObject::invokeMethod(m_loader, "imageLoaded", Qt::QueuedConnection,
+			      Q_ARG(QString, m_path), Q_ARG(QSize, m_size),
+			      Q_ARG(QImage, image), Q_ARG(uint, lastModified));
+  }
+
+private:
+  static void touch(const QString &path)
+  {
+    // access times are not updated on most mounts, the pruning relies
+    // on the modification time instead
+    QDateTime lastModified = QFileInfo(path).lastModified();
+    if (lastModified.secsTo(QDateTime::currentDateTime()) > TouchInterval)
+      utime(QFile::encodeName(path).constData(), 0);
+  }
+
+  void save(const QImage &image, const QString &path) const
+  {
+    // the thumbnail is written under a temporary name first, so that
+    // an interrupted write never leaves a truncated file to be read
+    QTemporaryFile file(QString("%1/%2XXXXXX").arg(m_cacheDirectory).arg(TemporaryPrefix));
+    if (file.open() && image.save(&file, "PNG") && file.rename(path))
+      file.setAutoRemove(false);
+    else if (!QFile::exists(path))
+      qWarning() << "CCoverLoader::Job::save: unable to write thumbnail " << path;
+  }
+
+  static QImage decode(const QString &path, const QSize &size)
+  {
+    // the JPEG decoder scales the image down while decoding it, which
+    // never allocates the full resolution image for a thumbnail
+    QImageReader reader(path);
+    QSize original = reader.size();
+    if (original.isValid())
+      {
+	reader.setScaledSize(original.scaled(size, Qt::KeepAspectRatio));
+	return reader.read();
+      }
+
+    QImage image = reader.read();
+    if (!image.isNull())
+      image = image.scaled(size, Qt::KeepAspectRatio, Qt::SmoothTransformation);
+    return image;
+  }
+
+  CCoverLoader *m_loader;
+  const QAtomicInt *m_canceled;
+  QString m_path;
+  QSize m_size;
+  QString m_cacheDirectory;
+};
+
+/// Runnable removing the least recently read thumbnails once the
+/// cache directory grows beyond its limit; reading a thumbnail
+/// updates its modification time.
+class CCoverLoader::Pruner : public QRunnable
+{
+public:
+  Pruner(CCoverLoader *loader, const QString &cacheDirectory)
+    : m_canceled(&loader->m_canceled)
+    , m_cacheDirectory(cacheDirectory)
+  {}
+
+  void run()
+  {
+    QFileInfoList files = QDir(m_cacheDirectory).entryInfoList(QDir::Files);
+    QDateTime expired = QDateTime::currentDateTime().addSecs(-TemporaryLifetime);
+    QMultiMap< QDateTime, QFileInfo > thumbnails;
+    foreach (const QFileInfo &file, files)
+      {
+	if (!file.fileName().startsWith(TemporaryPrefix))
+	  thumbnails.insert(file.lastModified(), file);
+	else if (file.lastModified() < expired)
+	  QFile::remove(file.filePath());
+      }
+
+    qint64 size = 0;
+    QMapIterator< QDateTime, QFileInfo > it(thumbnails);
+    it.toBack();
+    while (it.hasPrevious() && !*m_canceled)
+      {
+	const QFileInfo &file = it.previous().value();
+	size += file.size();
+	if (size > MaxDirectorySize)
+	  QFile::remove(file.filePath());
+      }
+  }
+
+private:
+  const QAtomicInt *m_canceled;
+  QString m_cacheDirectory;
+};
+
+CCoverLoader::CCoverLoader(QObject *parent)
+  : QObject(parent)
+  , m_cacheDirectory(QString("%1/covers").arg(QDesktopServices::storageLocation(QDesktopServices::CacheLocation)))
+  , m_caches()
+  , m_pool(new QThreadPool(this))
+  , m_canceled(0)
+  , m_pending()
+  , m_missing()
+  , m_lastModified()
+{
+  QDir().mkpath(m_cacheDirectory);
+  m_pool->start(new Pruner(this, m_cacheDirectory), PrefetchPriority - 1);
+}
+
+CCoverLoader::~CCoverLoader()
+{
+  // the jobs refer to the loader until they are done, the queued
+  // ones return as soon as they are started
+  m_canceled.fetchAndStoreOrdered(1);
+  m_pool->waitForDone();
+  qDeleteAll(m_caches);
+}
+
+QString CCoverLoader::thumbnailPath(const QString &cacheDirectory, const QFileInfo &info,
+				    const QSize &size)
+{
+  // a modified cover gets a new thumbnail
+  QByteArray hash = QCryptographicHash::hash(QString("%1:%2:%3")
+					     .arg(info.absoluteFilePath())
+					     .arg(info.lastModified().toTime_t())
+					     .arg(info.size()).toUtf8(),
+					     QCryptographicHash::Md5).toHex();
+  return QString("%1/%2-%3x%4.png").arg(cacheDirectory).arg(QString(hash))
+    .arg(size.width()).arg(size.height());
+}
+
+QString CCoverLoader::key(const QString &path, const QSize &size)
+{
+  return QString("cover-%1x%2-%3").arg(size.width()).arg(size.height()).arg(path);
+}
+
+CCoverLoader::PixmapCache * CCoverLoader::cache(const QSize &size) const
+{
+  PixmapCache *&cache = m_caches[qMakePair(size.width(), size.height())];
+  if (!cache)
+    cache = new PixmapCache;
+  return cache;
+}
+
+int CCoverLoader::cacheLimit(const QSize &size) const
+{
+  return cache(size)->maxCost();
+}
+
+void CCoverLoader::setCacheLimit(const QSize &size, int kilobytes)
+{
+  cache(size)->setMaxCost(kilobytes);
+}
+
+bool CCoverLoader::find(const QString &path, const QSize &size, QPixmap *pixmap) const
+{
+  QPixmap *cover = cache(size)->object(path);
+  if (!cover)
+    return false;
+
+  *pixmap = *cover;
+  return true;
+}
+
+bool CCoverLoader::isMissing(const QString &path) const
+{
+  return m_missing.contains(path);
+}
+
+void CCoverLoader::load(const QString &path, const QSize &size, Priority priority)
+{
+  QString coverKey = key(path, size);
+  if (m_missing.contains(path) || cache(size)->contains(path))
+    return;
+
+  // a prefetched cover that becomes visible is queued again ahead of
+  // the other prefetched ones, whichever job ends first provides it
+  QHash< QString, Priority >::iterator it = m_pending.find(coverKey);
+  if (it != m_pending.end() && *it >= priority)
+    return;
+
+  m_pending.insert(coverKey, priority);
+  m_pool->start(new Job(this, path, size, m_cacheDirectory), priority);
+}
+
+bool CCoverLoader::invalidate(const QString &path)
+{
+  QFileInfo info(path);
+  if (m_missing.contains(path))
+    {
+      if (!info.exists())
+	return false;
+      m_missing.remove(path);
+      return true;
+    }
+
+  QHash< QString, uint >::iterator it = m_lastModified.find(path);
+  if (it == m_lastModified.end()
+      || (info.exists() && info.lastModified().toTime_t() == *it))
+    return false;
+
+  // every size of the cover is loaded again
+  m_lastModified.erase(it);
+  foreach (PixmapCache *cache, m_caches)
+    cache->remove(path);
+  return true;
+}
+
+void CCoverLoader::clear()
+{
+  m_missing.clear();
+}
+
+void CCoverLoader::imageLoaded(const QString &path, const QSize &size, const QImage &image,
+			       uint lastModified)
+{
+  // pixmaps can only be created in the GUI thread
+  m_pending.remove(key(path, size));
+  if (image.isNull())
+    {
+      m_missing.insert(path);
+      m_lastModified.remove(path);
+      emit(loaded(path));
+      return;
+    }
+
+  insert(path, size, image, lastModified);
+  emit(loaded(path));
+}
+
+void CCoverLoader::insert(const QString &path, const QSize &size, const QImage &image,
+			  uint lastModified)
+{
+  m_lastModified.insert(path, lastModified);
+  cache(size)->insert(path, new QPixmap(QPixmap::fromImage(image)),
+		      qMax(image.byteCount() / 1024, 1));
+}
@@ -0,0 +1,123 @@
+// Copyright (C) 2009-2011, Romain Goffe <romain.goffe@gmail.com>
+// Copyright (C) 2009-2011, Alexandre Dupas <alexandre.dupas@gmail.com>
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License as
+// published by the Free Software Foundation; either version 2 of the
+// License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+// 02110-1301, USA.
+//******************************************************************************
+
+/**
+ * \file cover-loader.hh
+ *
+ * Background loading of the cover thumbnails.
+ *
+ */
+#ifndef __COVER_LOADER_HH__
+#define __COVER_LOADER_HH__
+
+#include <QObject>
+#include <QString>
+#include <QSet>
+#include <QHash>
+#include <QMap>
+#include <QPair>
+#include <QCache>
+#include <QSize>
+#include <QImage>
+#include <QPixmap>
+#include <QAtomicInt>
+
+class QThreadPool;
+class QFileInfo;
+
+/**
+ * \class CCoverLoader
+ *
+ * Decodes and scales the covers on a pool of worker threads.
+ *
+ * find() only looks up the thumbnails already loaded, so that views
+ * never wait for the disk: a cover that is not there yet is queued
+ * with load() and loaded() is emitted once it is available. Covers
+ * needed by the visible rows are loaded before the prefetched ones,
+ * and a prefetched cover that becomes visible is queued again at the
+ * higher priority. The jobs still queued when the loader is
+ * destroyed return without decoding anything.
+ * Files that could not be read are remembered as missing until
+ * clear() is called, invalidate() drops a cover that changed on disk.
+ *
+ * Scaled covers are also saved in the cache directory of the
+ * application, under a name derived from the path, modification time
+ * and size of the original file, so that the next sessions read the
+ * thumbnails instead of decoding the full covers again. The least
+ * recently read thumbnails are removed in the background when the
+ * loader starts if the directory grows too large.
+ *
+ * Loaded thumbnails are kept in memory by a cache of their own for
+ * each size, keyed by the path of the cover and bounded by the number
+ * of kilobytes given to setCacheLimit(); the least recently used ones
+ * are dropped first.
+ */
+class CCoverLoader : public QObject
+{
+  Q_OBJECT
+
+public:
+  enum Priority
+    {
+      PrefetchPriority = 0,
+      VisiblePriority = 1
+    };
+
+  CCoverLoader(QObject *parent = 0);
+  ~CCoverLoader();
+
+  bool find(const QString &path, const QSize &size, QPixmap *pixmap) const;
+  int cacheLimit(const QSize &size) const;
+  void setCacheLimit(const QSize &size, int kilobytes);
+
+  bool isMissing(const QString &path) const;
+  void load(const QString &path, const QSize &size, Priority priority = VisiblePriority);
+  bool invalidate(const QString &path);
+  void clear();
+
+signals:
+  void loaded(const QString &path);
+
+private slots:
+  void imageLoaded(const QString &path, const QSize &size, const QImage &image,
+		   uint lastModified);
+
+private:
+  class Job;
+  class Pruner;
+
+  typedef QCache< QString, QPixmap > PixmapCache;
+
+  static QString thumbnailPath(const QString &cacheDirectory, const QFileInfo &info,
+			       const QSize &size);
+  static QString key(const QString &path, const QSize &size);
+  void insert(const QString &path, const QSize &size, const QImage &image,
+	      uint lastModified);
+  PixmapCache * cache(const QSize &size) const;
+
+  QString m_cacheDirectory;
+  mutable QMap< QPair< int, int >, PixmapCache* > m_caches;
+  QThreadPool *m_pool;
+  QAtomicInt m_canceled;
+  QHash< QString, Priority > m_pending;
+  QSet< QString > m_missing;
+  QHash< QString, uint > m_lastModified;
+};
+
+#endif // __COVER_LOADER_HH__
@@ -23,6 +23,7 @@
 #include <QPainter>
 #include <QMenu>
 #include <QAction>
+#include <QTimer>
 
 #include <QDebug>
 
@@ -133,6 +134,9 @@ void CMagButton::paintEvent(QPaintEvent *event)
 CFilterLineEdit::CFilterLineEdit(QWidget *parent)
   : LineEdit(parent)
   , m_menu(new QMenu)
+  , m_filterTimer(new QTimer(this))
+  , m_fuzzyAct(0)
+  , m_relevanceAct(0)
   , m_filterModel(0)
 {
   CClearButton *clearButton = new CClearButton(this);
@@ -197,6 +201,18 @@ CFilterLineEdit::CFilterLineEdit(QWidget *parent)
   connect(action, SIGNAL(triggered()), SLOT(filterLanguageSpanish()));
   addAction(action);
 
+  m_menu->addSeparator();
+
+  m_fuzzyAct = new QAction(tr("Approximate search"), this);
+  m_fuzzyAct->setStatusTip(tr("Also show songs that nearly match the filter"));
+  m_fuzzyAct->setCheckable(true);
+  addAction(m_fuzzyAct);
+
+  m_relevanceAct = new QAction(tr("Sort by relevance"), this);
+  m_relevanceAct->setStatusTip(tr("Show the songs that best match the filter first"));
+  m_relevanceAct->setCheckable(true);
+  addAction(m_relevanceAct);
+
   updateTextMargins();
   setInactiveText(tr("Filter"));
 }
@@ -212,8 +228,24 @@ void CFilterLineEdit::addAction(QAction* action)
 void CFilterLineEdit::setFilterModel(CSongSortFilterProxyModel *filterModel)
 {
   m_filterModel = filterModel;
+  m_filterModel->setBackgroundFiltering(true);
+  connect(m_fuzzyAct, SIGNAL(toggled(bool)),
+	  filterModel, SLOT(setFuzzyMatching(bool)));
+  connect(m_relevanceAct, SIGNAL(toggled(bool)),
+	  filterModel, SLOT(setSortByRelevance(bool)));
+
+  // keystrokes are coalesced before the filter is applied
+  m_filterTimer->setSingleShot(true);
+  m_filterTimer->setInterval(150);
   connect(this, SIGNAL(textChanged(const QString&)),
-	  filterModel, SLOT(setFilterString(const QString&)));
+	  m_filterTimer, SLOT(start()));
+  connect(m_filterTimer, SIGNAL(timeout()), SLOT(applyFilter()));
+}
+
+void CFilterLineEdit::applyFilter()
+{
+  if (m_filterModel)
+    m_filterModel->setFilterString(text());
 }
 
 void CFilterLineEdit::filterLanguageEnglish()
@@ -61,6 +61,7 @@ private:
 };
 
 class QAction;
+class QTimer;
 class CSongSortFilterProxyModel;
 
 class CFilterLineEdit : public LineEdit
@@ -80,8 +81,14 @@ public:
 
   void setFilterModel(CSongSortFilterProxyModel *filterModel);
 
+private slots:
+  void applyFilter();
+
 private:
   QMenu* m_menu;
+  QTimer *m_filterTimer;
+  QAction *m_fuzzyAct;
+  QAction *m_relevanceAct;
 
   CSongSortFilterProxyModel *m_filterModel;
 };
@@ -20,6 +20,7 @@
 #include <QtGui>
 
 #include "main-window.hh"
+#include "library.hh"
 #include "song-panel.hh"
 
 #include <QDebug>
@@ -37,6 +38,8 @@ CLibraryView::CLibraryView(CMainWindow *parent)
 
   setContextMenuPolicy(Qt::ActionsContextMenu);
 
+  connect(verticalScrollBar(), SIGNAL(valueChanged(int)), SLOT(prefetchCovers()));
+
   createActions();
 }
 
@@ -67,10 +70,23 @@ void CLibraryView::writeSettings()
 
 void CLibraryView::update()
 {
-  sortByColumn(0, Qt::AscendingOrder);
+  // songs of an artist are ordered by title
   sortByColumn(1, Qt::AscendingOrder);
 }
 
+void CLibraryView::prefetchCovers()
+{
+  // the covers of the next page are loaded once the visible ones are
+  int last = rowAt(viewport()->height() - 1);
+  if (last == -1 || isColumnHidden(4))
+    return;
+
+  int count = viewport()->height() / qMax(rowHeight(last), 1);
+  int end = qMin(last + 1 + count, model()->rowCount());
+  for (int row = last + 1; row < end; ++row)
+    parent()->library()->prefetchCover(model()->index(row, 4).data(CLibrary::CoverRole).toString());
+}
+
 void CLibraryView::createActions()
 {
   connect(this, SIGNAL(doubleClicked(const QModelIndex &)),
@@ -46,6 +46,9 @@ public slots:
   void update();
   void songInfo();
 
+private slots:
+  void prefetchCovers();
+
 private:
   void createActions();
   CMainWindow * parent() const;
@@ -19,32 +19,154 @@
 #include "library.hh"
 
 #include <QtGui>
+#include <QtConcurrentMap>
+#include <QtConcurrentRun>
+#include <QFutureWatcher>
 
 #include "main-window.hh"
+#include "song-scanner.hh"
+#include "song-store.hh"
+#include "completion-model.hh"
+#include "cover-loader.hh"
 #include "utils/utils.hh"
 
 #include <QDebug>
 
+namespace
+{
+  const quint32 IndexMagic = 0x53424958; // "SBIX"
+  const quint32 IndexVersion = 2;
+
+  const QSize SmallCoverSize(24, 24);
+  const QSize FullCoverSize(128, 128);
+
+  // memory used by the covers of each size, in kilobytes
+  const int SmallCoverCacheLimit = 4096;
+  const int FullCoverCacheLimit = 16384;
+}
+
+QDataStream & operator<<(QDataStream &out, const CLibrary::Song &song)
+{
+  out << song.path << song.lastModified << song.size
+      << song.title << song.artist << song.album
+      << song.coverName << song.coverPath
+      << qint32(song.language) << song.isLilypond
+      << song.lyrics;
+  return out;
+}
+
+QDataStream & operator>>(QDataStream &in, CLibrary::Song &song)
+{
+  qint32 language;
+  in >> song.path >> song.lastModified >> song.size
+     >> song.title >> song.artist >> song.album
+     >> song.coverName >> song.coverPath
+     >> language >> song.isLilypond
+     >> song.lyrics;
+  song.language = QLocale::Language(language);
+  return in;
+}
+
+/// Functor used to load the songs of the library on worker threads.
+/// Songs whose modification time and size match the index are
+/// reused as is, the others are parsed again. Indexed songs that lack
+/// the words of their lyrics are parsed again when they are needed.
+class CLibrary::SongLoader
+{
+public:
+  typedef Song result_type;
+
+  SongLoader(const QHash< QString, Song > &index, bool lyrics)
+    : m_index(index)
+    , m_lyrics(lyrics)
+  {}
+
+  Song operator()(const QString &path) const
+  {
+    QHash< QString, Song >::const_iterator it = m_index.constFind(path);
+    if (it != m_index.constEnd() && (!m_lyrics || !it->lyrics.isNull()))
+      {
+	QFileInfo info(path);
+	if (it->size == info.size()
+	    && it->lastModified == info.lastModified().toTime_t())
+	  {
+	    Song song = *it;
+	    if (!m_lyrics)
+	      song.lyrics = QByteArray();
+	    return song;
+	  }
+      }
+
+    return loadSong(path, m_lyrics);
+  }
+
+private:
+  QHash< QString, Song > m_index;
+  bool m_lyrics;
+};
+
 CLibrary::CLibrary(CMainWindow *parent)
   : QAbstractTableModel()
   , m_parent(parent)
   , m_directory()
-  , m_completionModel(new QStringListModel(this))
+  , m_canonicalPath()
+  , m_completionModel(new CCompletionModel(this))
+  , m_coverLoader(new CCoverLoader(this))
+  , m_coverRequests()
   , m_templates()
-  , m_songs()
+  , m_lyricsIndexed(false)
+  , m_songs(new CSongStore)
+  , m_rows()
+  , m_watcher(new QFileSystemWatcher(this))
+  , m_watcherTimer(new QTimer(this))
+  , m_pendingDirectories()
+  , m_watchedCovers()
+  , m_listingWatcher(new QFutureWatcher< Listing >(this))
+  , m_scanWatcher(new QFutureWatcher< Song >(this))
+  , m_scanBuffer()
+  , m_scanSeen()
+  , m_scanReplacesAll(false)
+  , m_changeWatcher(new QFutureWatcher< Song >(this))
+  , m_changedPaths()
+  , m_queuedPaths()
 {
   connect(this, SIGNAL(directoryChanged(const QDir&)), SLOT(update()));
+
+  connect(m_listingWatcher, SIGNAL(finished()), SLOT(songsListed()));
+  connect(m_scanWatcher, SIGNAL(resultsReadyAt(int, int)), SLOT(songsLoaded(int, int)));
+  connect(m_scanWatcher, SIGNAL(finished()), SLOT(songsScanned()));
+  connect(m_changeWatcher, SIGNAL(finished()), SLOT(changedSongsLoaded()));
+
+  connect(m_coverLoader, SIGNAL(loaded(const QString&)), SLOT(coverLoaded(const QString&)));
+
+  // filesystem events are coalesced before being applied to the library
+  m_watcherTimer->setSingleShot(true);
+  m_watcherTimer->setInterval(500);
+  connect(m_watcher, SIGNAL(directoryChanged(const QString&)),
+	  SLOT(songsDirectoryChanged(const QString&)));
+  connect(m_watcher, SIGNAL(fileChanged(const QString&)),
+	  SLOT(coverChanged(const QString&)));
+  connect(m_watcherTimer, SIGNAL(timeout()), SLOT(applyPendingChanges()));
 }
 
 CLibrary::~CLibrary()
 {
-  m_songs.clear();
+  m_listingWatcher->cancel();
+  m_scanWatcher->cancel();
+  m_changeWatcher->cancel();
+  m_listingWatcher->waitForFinished();
+  m_scanWatcher->waitForFinished();
+  m_changeWatcher->waitForFinished();
+  delete m_songs;
 }
 
 void CLibrary::readSettings()
 {
   QSettings settings;
   settings.beginGroup("library");
+  setLyricsIndexed(settings.value("lyricsIndex", false).toBool());
+  m_coverLoader->setCacheLimit(SmallCoverSize, SmallCoverCacheLimit);
+  m_coverLoader->setCacheLimit(FullCoverSize, FullCoverCacheLimit);
   setDirectory(settings.value("workingPath", findSongbookPath()).toString());
   settings.endGroup();
 }
@@ -54,6 +176,7 @@ void CLibrary::writeSettings()
   QSettings settings;
   settings.beginGroup("library");
   settings.setValue("workingPath", directory().absolutePath());
+  settings.setValue("lyricsIndex", isLyricsIndexed());
   settings.endGroup();
 }
 
@@ -87,6 +210,11 @@ QDir CLibrary::directory() const
   return m_directory;
 }
 
+QString CLibrary::canonicalPath() const
+{
+  return m_canonicalPath;
+}
+
 void CLibrary::setDirectory(const QString &directory)
 {
   if(!directory.isEmpty())
@@ -97,8 +225,21 @@ void CLibrary::setDirectory(const QDir &directory)
 {
   if(directory != m_directory)
     {
+      // songs from the previous library are dropped right away
+      cancelUpdate();
+      if (!m_songs->isEmpty())
+	{
+	  beginResetModel();
+	  m_songs->clear();
+	  m_rows.clear();
+	  m_completionModel->clear();
+	  endResetModel();
+	}
+      unwatchCovers(m_watchedCovers.toList());
+
       m_directory = directory;
-      QDir templatesDirectory(QString("%1/templates").arg(directory.canonicalPath()));
+      m_canonicalPath = directory.canonicalPath();
+      QDir templatesDirectory(QString("%1/templates").arg(m_canonicalPath));
       m_templates = templatesDirectory.entryList(QStringList() << "*.tmpl");
       writeSettings();
       emit(directoryChanged(m_directory));
@@ -174,191 +315,839 @@ QVariant CLibrary::data(const QModelIndex &index, int role) const
         }
       break;
     case TitleRole:
-      return m_songs[index.row()].title;
+      return m_songs->title(index.row());
     case ArtistRole:
-      return m_songs[index.row()].artist;
+      return m_songs->artist(index.row());
     case AlbumRole:
-      return m_songs[index.row()].album;
+      return m_songs->album(index.row());
     case CoverRole:
-      return QString("%1/%2.jpg")
-	.arg(m_songs[index.row()].coverPath)
-	.arg(m_songs[index.row()].coverName);
+      return m_songs->cover(index.row());
     case LilypondRole:
-      return m_songs[index.row()].isLilypond;
+      return m_songs->isLilypond(index.row());
     case LanguageRole:
-      return qVariantFromValue(m_songs[index.row()].language);
+      return qVariantFromValue(m_songs->language(index.row()));
     case PathRole:
-      return m_songs[index.row()].path;
+      return m_songs->path(index.row());
     case RelativePathRole:
-      return QDir(QString("%1/songs").arg(directory().canonicalPath())).relativeFilePath(m_songs[index.row()].path);
+      return m_songs->relativePath(index.row());
     case CoverSmallRole:
-      {
-        QPixmap pixmap;
-	QFileInfo file = QFileInfo(data(index, CoverRole).toString());
-	if (file.exists())
-          {
-            if (!QPixmapCache::find(file.baseName()+"-small", &pixmap))
-              {
-                pixmap = QPixmap::fromImage(QImage(file.filePath()).scaledToWidth(24));
-                QPixmapCache::insert(file.baseName()+"-small", pixmap);
-              }
-            return pixmap;
-          }
-      }
-      return QVariant();
+      return cover(index, SmallCoverSize);
     case CoverFullRole:
-      {
-	QPixmap pixmap;
-	QFileInfo file = QFileInfo(data(index, CoverRole).toString());
-	if (file.exists())
-          {
-            if (!QPixmapCache::find(file.baseName()+"-full", &pixmap))
-              {
-                pixmap = QPixmap::fromImage(QImage(file.filePath()).scaled(128,128));
-                QPixmapCache::insert(file.baseName()+"-full", pixmap);
-              }
-            return pixmap;
-          }
-      }
-      return QVariant();
+      return cover(index, FullCoverSize);
+    }
+  return QVariant();
+}
+
+QVariant CLibrary::cover(const QModelIndex &index, const QSize &size) const
+{
+  const QString &path = m_songs->cover(index.row());
+  QPixmap pixmap;
+  if (m_coverLoader->find(path, size, &pixmap))
+    return pixmap;
+
+  // the row is repainted once its cover is loaded in the background
+  if (!m_coverLoader->isMissing(path))
+    {
+      QList< QPersistentModelIndex > &requests = m_coverRequests[path];
+      if (!requests.contains(index))
+	requests << QPersistentModelIndex(index);
+      m_coverLoader->load(path, size);
     }
   return QVariant();
 }
 
+void CLibrary::prefetchCover(const QString &path)
+{
+  m_coverLoader->load(path, SmallCoverSize, CCoverLoader::PrefetchPriority);
+}
+
+void CLibrary::coverLoaded(const QString &path)
+{
+  // a cover rewritten in place does not change its directory, the
+  // loaded covers are watched on their own
+  if (!m_coverLoader->isMissing(path) && !m_watchedCovers.contains(path))
+    {
+      m_watchedCovers.insert(path);
+      m_watcher->addPath(path);
+    }
+
+  foreach (const QPersistentModelIndex &index, m_coverRequests.take(path))
+    {
+      if (index.isValid())
+	emit(dataChanged(index, index));
+    }
+}
+
+void CLibrary::coverChanged(const QString &path)
+{
+  // a cover replaced by another file is watched again, a removed one
+  // is not watched anymore until it is loaded again
+  m_watcher->removePath(path);
+  if (QFileInfo(path).exists())
+    m_watcher->addPath(path);
+  else
+    m_watchedCovers.remove(path);
+
+  int id = m_songs->covers().indexOf(path);
+  if (id == -1 || !m_coverLoader->invalidate(path))
+    return;
+
+  repaintCovers(QSet< int >() << id);
+}
+
+void CLibrary::unwatchCovers(const QStringList &paths)
+{
+  if (paths.isEmpty())
+    return;
+
+  m_watcher->removePaths(paths);
+  foreach (const QString &path, paths)
+    m_watchedCovers.remove(path);
+}
+
+void CLibrary::unwatchUnusedCovers()
+{
+  QSet< int > used;
+  for (int row = 0; row < m_songs->size(); ++row)
+    used.insert(m_songs->coverId(row));
+
+  QStringList unused;
+  foreach (const QString &path, m_watchedCovers)
+    {
+      if (!used.contains(m_songs->covers().indexOf(path)))
+	unused << path;
+    }
+  unwatchCovers(unused);
+}
+
+void CLibrary::updateCovers(const QStringList &directories)
+{
+  const CStringPool &covers = m_songs->covers();
+  QSet< int > changed;
+  for (int id = 0; id < covers.size(); ++id)
+    {
+      const QString &path = covers.at(id);
+      if (directories.contains(path.left(path.lastIndexOf('/')))
+	  && m_coverLoader->invalidate(path))
+	changed.insert(id);
+    }
+
+  if (!changed.isEmpty())
+    repaintCovers(changed);
+}
+
+void CLibrary::repaintCovers(const QSet< int > &covers)
+{
+  // the songs sharing a cover that changed on disk are all repainted
+  // with the new image
+  for (int row = 0; row < m_songs->size(); ++row)
+    {
+      if (covers.contains(m_songs->coverId(row)))
+	emit(dataChanged(index(row, 4), index(row, 4)));
+    }
+}
+
 void CLibrary::update()
 {
-  m_songs.clear();
+  cancelUpdate();
 
-  // get the path of each song in the library
-  QStringList filter = QStringList() << "*.sg";
-  QString path = directory().absoluteFilePath("songs/");
-  QStringList paths;
+  // the scan picks up the songs that were being loaded
+  m_changeWatcher->cancel();
+  m_queuedPaths.clear();
 
-  QDirIterator it(path, filter, QDir::NoFilter, QDirIterator::Subdirectories);
-  while(it.hasNext())
-    paths.append(it.next());
+  // the directory may have been created or moved since it was set
+  m_canonicalPath = m_directory.canonicalPath();
+  m_songs->setRootDirectory(QString("%1/songs").arg(m_canonicalPath));
+
+  // covers may have been added since they were found missing
+  m_coverLoader->clear();
 
+  // the progress bar follows the number of loaded songs
+  connect(m_scanWatcher, SIGNAL(progressRangeChanged(int, int)),
+	  m_parent->progressBar(), SLOT(setRange(int, int)), Qt::UniqueConnection);
+  connect(m_scanWatcher, SIGNAL(progressValueChanged(int)),
+	  m_parent->progressBar(), SLOT(setValue(int)), Qt::UniqueConnection);
+
+  // the directory walk and the index loading are done in the background
   m_parent->progressBar()->show();
+  m_parent->progressBar()->setRange(0, 0);
+  m_listingWatcher->setFuture(QtConcurrent::run(&CLibrary::listSongs,
+						directory().absoluteFilePath("songs"),
+						indexPath()));
+  emit(updating(true));
+}
+
+void CLibrary::cancelUpdate()
+{
+  if (!isUpdating())
+    return;
+
+  m_listingWatcher->cancel();
+  m_scanWatcher->cancel();
+  m_scanBuffer.clear();
+  m_scanSeen.clear();
+
+  m_parent->progressBar()->setTextVisible(false);
+  m_parent->progressBar()->setRange(0, 0);
+  m_parent->progressBar()->hide();
+  m_parent->statusBar()->showMessage(tr("Song database update cancelled."));
+  emit(updating(false));
+}
+
+bool CLibrary::isUpdating() const
+{
+  return m_listingWatcher->isRunning() || m_scanWatcher->isRunning();
+}
+
+const CSongStore * CLibrary::songs() const
+{
+  return m_songs;
+}
+
+int CLibrary::compare(int leftRow, int rightRow, int column) const
+{
+  // columns are compared on the keys computed when the songs are
+  // stored, rather than on the strings returned by data()
+  int result = 0;
+  switch (column)
+    {
+    case 0:
+      result = qstrcmp(m_songs->titleKey(leftRow), m_songs->titleKey(rightRow));
+      break;
+    case 1:
+      if (m_songs->artistId(leftRow) != m_songs->artistId(rightRow))
+	result = qstrcmp(m_songs->artistKey(leftRow), m_songs->artistKey(rightRow));
+      break;
+    case 2:
+      result = int(m_songs->isLilypond(leftRow)) - int(m_songs->isLilypond(rightRow));
+      break;
+    case 3:
+      result = qstrcmp(m_songs->pathKey(leftRow), m_songs->pathKey(rightRow));
+      break;
+    case 4:
+      if (m_songs->albumId(leftRow) != m_songs->albumId(rightRow))
+	result = qstrcmp(m_songs->albumKey(leftRow), m_songs->albumKey(rightRow));
+      break;
+    case 5:
+      if (m_songs->language(leftRow) != m_songs->language(rightRow))
+	result = qstrcmp(m_songs->languageKey(leftRow), m_songs->languageKey(rightRow));
+      break;
+    }
+
+  // equal rows are ordered by title then path, which sorts the songs
+  // of an artist by title in a single pass
+  if (result == 0 && column != 0)
+    result = qstrcmp(m_songs->titleKey(leftRow), m_songs->titleKey(rightRow));
+  if (result == 0 && column != 3)
+    result = QString::compare(m_songs->path(leftRow), m_songs->path(rightRow));
+  return result;
+}
+
+bool CLibrary::isLyricsIndexed() const
+{
+  return m_lyricsIndexed;
+}
+
+void CLibrary::setLyricsIndexed(bool indexed)
+{
+  if (m_lyricsIndexed == indexed)
+    return;
+
+  // the songs are loaded again, mostly from the on-disk index, and
+  // every row is replaced since the files themselves did not change
+  m_lyricsIndexed = indexed;
+  if (!m_songs->isEmpty())
+    {
+      m_scanReplacesAll = true;
+      update();
+    }
+}
+
+CLibrary::Listing CLibrary::listSongs(const QString &path, const QString &indexPath)
+{
+  Listing listing;
+  listing.directories << path;
+  readIndex(indexPath, listing.index);
+
+  QDirIterator it(path, QDir::AllEntries | QDir::NoDotAndDotDot, QDirIterator::Subdirectories);
+  while(it.hasNext())
+    {
+      it.next();
+      if (it.fileInfo().isDir())
+	listing.directories.append(it.filePath());
+      else if (it.fileInfo().suffix() == "sg")
+	listing.songs.append(it.filePath());
+    }
+  return listing;
+}
+
+void CLibrary::songsListed()
+{
+  if (m_listingWatcher->isCanceled())
+    return;
+
+  Listing listing = m_listingWatcher->result();
+
+  // watch the directories to keep the library up to date
+  m_pendingDirectories.clear();
+  if (!m_watcher->directories().isEmpty())
+    m_watcher->removePaths(m_watcher->directories());
+  if (QFileInfo(listing.directories.first()).isDir())
+    m_watcher->addPaths(listing.directories);
+
+  // songs that are already in the library are fresher than the index
+  for (int i = 0; i < m_songs->size(); ++i)
+    listing.index.insert(m_songs->path(i), m_songs->song(i));
+  m_scanSeen.clear();
+  m_scanBuffer.clear();
+
+  // load the songs on every available core, the results are merged
+  // into the library by chunks as they arrive
   m_parent->progressBar()->setTextVisible(true);
-  m_parent->progressBar()->setRange(0, paths.size());
+  m_scanWatcher->setFuture(QtConcurrent::mapped(listing.songs, SongLoader(listing.index, m_lyricsIndexed)));
+}
+
+void CLibrary::songsLoaded(int begin, int end)
+{
+  QList< int > replaced;
+  for (int i = begin; i < end; ++i)
+    {
+      Song song = m_scanWatcher->resultAt(i);
+      if (song.path.isEmpty())
+	continue;
+
+      m_scanSeen.insert(song.path);
+      QHash< QString, int >::const_iterator it = m_rows.constFind(song.path);
+      if (it == m_rows.constEnd())
+	{
+	  m_scanBuffer << song;
+	}
+      else if (m_scanReplacesAll
+	       || m_songs->lastModified(*it) != song.lastModified
+	       || m_songs->fileSize(*it) != song.size)
+	{
+	  replaceSong(*it, song, false);
+	  replaced << *it;
+	}
+    }
+  notifyRowsChanged(replaced);
+
+  if (m_scanBuffer.size() >= ScanChunkSize)
+    {
+      insertSongs(m_scanBuffer);
+      m_scanBuffer.clear();
+    }
+}
+
+void CLibrary::songsScanned()
+{
+  if (m_scanWatcher->isCanceled())
+    return;
 
-  addSongs(paths);
+  insertSongs(m_scanBuffer);
+  m_scanBuffer.clear();
 
-  QStringList wordList;
-  for (int i = 0; i < rowCount(); ++i)
+  // remove the songs that have not been found during the scan
+  QList< int > removed;
+  QHash< QString, int >::const_iterator it;
+  for (it = m_rows.constBegin(); it != m_rows.constEnd(); ++it)
     {
-      wordList << data(index(i,0),CLibrary::TitleRole).toString()
-	       << data(index(i,0),CLibrary::ArtistRole).toString()
-	       << data(index(i,0),CLibrary::PathRole).toString();
+      if (!m_scanSeen.contains(it.key()))
+	removed << it.value();
     }
-  wordList.removeDuplicates();
-  m_completionModel->setStringList(wordList);
+  m_scanSeen.clear();
+  m_scanReplacesAll = false;
+  removeSongs(removed);
+
+  writeIndex();
 
   m_parent->progressBar()->setTextVisible(false);
   m_parent->progressBar()->setRange(0, 0);
   m_parent->progressBar()->hide();
   m_parent->statusBar()->showMessage(tr("Song database updated."));
+  emit(updating(false));
   emit(wasModified());
 }
 
-void CLibrary::addSongs(const QStringList &paths)
+QStringList CLibrary::completionWords(int row) const
 {
-  // run through the library songs files
-  uint count = 0;
-  QStringListIterator filepath(paths);
-  while (filepath.hasNext())
+  // the strings are shared with the song store
+  return QStringList() << m_songs->title(row)
+		       << m_songs->artist(row)
+		       << m_songs->path(row);
+}
+
+void CLibrary::replaceSong(int row, const Song &song, bool notify)
+{
+  // rescanning the lyrics leaves the completion words as they are
+  QStringList words = completionWords(row);
+  m_songs->replace(row, song);
+  QStringList newWords = completionWords(row);
+  if (newWords != words)
     {
-      m_parent->progressBar()->setValue(++count);
-      addSong(filepath.next());
+      m_completionModel->removeWords(words);
+      m_completionModel->addWords(newWords);
     }
-  reset();
-  emit(wasModified());
+
+  if (notify)
+    emit(dataChanged(index(row, 0), index(row, columnCount() - 1)));
+}
+
+void CLibrary::notifyRowsChanged(QList< int > rows)
+{
+  // one notification per run of consecutive rows
+  qSort(rows);
+  int i = 0;
+  while (i < rows.size())
+    {
+      int first = rows[i];
+      int last = first;
+      while (++i < rows.size() && rows[i] <= last + 1)
+	last = rows[i];
+      emit(dataChanged(index(first, 0), index(last, columnCount() - 1)));
+    }
+}
+
+void CLibrary::songsDirectoryChanged(const QString &path)
+{
+  m_pendingDirectories.insert(path);
+  m_watcherTimer->start();
+}
+
+void CLibrary::applyPendingChanges()
+{
+  if (m_pendingDirectories.isEmpty())
+    return;
+
+  // the running scan already picks up the changes
+  if (isUpdating())
+    {
+      m_watcherTimer->start();
+      return;
+    }
+
+  // index the known songs by directory
+  QHash< QString, QList< int > > rowsByDirectory;
+  for (int i = 0; i < m_songs->size(); ++i)
+    rowsByDirectory[m_songs->directory(i)] << i;
+
+  QStringList pending = m_pendingDirectories.toList();
+  m_pendingDirectories.clear();
+  updateCovers(pending);
+
+  QSet< QString > watched = m_watcher->directories().toSet();
+  QSet< QString > scannedDirectories;
+  QHash< QString, QFileInfo > present;
+
+  foreach (const QString &directory, pending)
+    {
+      if (!QFileInfo(directory).isDir())
+	{
+	  m_watcher->removePath(directory);
+	  continue;
+	}
+
+      // list the songs of the directory, new subdirectories are
+      // watched and scanned recursively
+      QStringList directories(directory);
+      while (!directories.isEmpty())
+	{
+	  QString current = directories.takeFirst();
+	  scannedDirectories.insert(current);
+	  QFileInfoList entries = QDir(current).entryInfoList(QDir::AllEntries | QDir::NoDotAndDotDot);
+	  foreach (const QFileInfo &entry, entries)
+	    {
+	      if (entry.isDir())
+		{
+		  if (!watched.contains(entry.absoluteFilePath()))
+		    {
+		      m_watcher->addPath(entry.absoluteFilePath());
+		      watched.insert(entry.absoluteFilePath());
+		      directories << entry.absoluteFilePath();
+		    }
+		}
+	      else if (entry.suffix() == "sg")
+		{
+		  present.insert(entry.absoluteFilePath(), entry);
+		}
+	    }
+	}
+    }
+
+  // compare the known songs of the modified directories, or of the
+  // directories that do not exist anymore, against the filesystem
+  QList< int > removed;
+  QHash< QString, int > modified;
+  QHash< QString, QList< int > >::const_iterator it;
+  for (it = rowsByDirectory.constBegin(); it != rowsByDirectory.constEnd(); ++it)
+    {
+      if (!scannedDirectories.contains(it.key()))
+	{
+	  bool concerned = false;
+	  foreach (const QString &directory, pending)
+	    {
+	      if (it.key() == directory || it.key().startsWith(directory + "/"))
+		{
+		  concerned = true;
+		  break;
+		}
+	    }
+	  if (!concerned || QFileInfo(it.key()).isDir())
+	    continue;
+	}
+
+      foreach (int row, it.value())
+	{
+	  const QString &path = m_songs->path(row);
+	  QHash< QString, QFileInfo >::iterator file = present.find(path);
+	  if (file == present.end())
+	    {
+	      removed << row;
+	      continue;
+	    }
+	  if (m_songs->fileSize(row) != file->size()
+	      || m_songs->lastModified(row) != file->lastModified().toTime_t())
+	    modified.insert(path, row);
+	  present.erase(file);
+	}
+    }
+
+  removeSongs(removed);
+
+  // the new and modified songs are parsed in the background
+  loadSongs(modified.keys() + present.keys());
+}
+
+void CLibrary::loadSongs(const QStringList &paths)
+{
+  m_queuedPaths << paths;
+  if (m_changeWatcher->isRunning() || m_queuedPaths.isEmpty())
+    return;
+
+  m_changedPaths = m_queuedPaths;
+  m_queuedPaths.clear();
+  m_changeWatcher->setFuture(QtConcurrent::mapped(m_changedPaths, SongLoader(QHash< QString, Song >(), m_lyricsIndexed)));
+}
+
+void CLibrary::changedSongsLoaded()
+{
+  // the rows are looked up once the songs are parsed since the
+  // library may have changed meanwhile; known songs that cannot be
+  // parsed anymore are removed
+  if (!m_changeWatcher->isCanceled())
+    {
+      QList< int > replaced;
+      QList< int > removed;
+      QList< Song > added;
+      QSet< QString > addedPaths;
+      for (int i = 0; i < m_changedPaths.size(); ++i)
+	{
+	  Song song = m_changeWatcher->resultAt(i);
+	  QHash< QString, int >::const_iterator row = m_rows.constFind(m_changedPaths[i]);
+	  if (row == m_rows.constEnd())
+	    {
+	      if (!song.path.isEmpty() && !addedPaths.contains(song.path))
+		{
+		  addedPaths.insert(song.path);
+		  added << song;
+		}
+	    }
+	  else if (song.path.isEmpty())
+	    {
+	      removed << *row;
+	    }
+	  else
+	    {
+	      replaceSong(*row, song, false);
+	      replaced << *row;
+	    }
+	}
+
+      notifyRowsChanged(replaced);
+      removeSongs(removed);
+      insertSongs(added);
+    }
+
+  m_changedPaths.clear();
+  loadSongs(QStringList());
 }
 
-QRegExp CLibrary::reSong("begin\\{?song\\}?\\{([^[\\}]+)\\}[^[]*\\[([^]]*)\\]");
-QRegExp CLibrary::reArtist("by=([^,]+)");
-QRegExp CLibrary::reAlbum("album=([^,]+)");
-QRegExp CLibrary::reCoverName("cov=([^,]+)");
-QRegExp CLibrary::reLilypond("\\\\lilypond");
-QRegExp CLibrary::reLanguage("selectlanguage\\{([^\\}]+)");
+void CLibrary::insertSongs(const QList< Song > &songs)
+{
+  if (songs.isEmpty())
+    return;
+
+  // songs added while a scan is running must survive its end
+  for (int i = 0; i < songs.size(); ++i)
+    {
+      m_rows.insert(songs[i].path, m_songs->size() + i);
+      if (isUpdating())
+	m_scanSeen.insert(songs[i].path);
+    }
+
+  int first = m_songs->size();
+  beginInsertRows(QModelIndex(), first, first + songs.size() - 1);
+  foreach (const Song &song, songs)
+    m_songs->append(song);
+  endInsertRows();
 
+  QStringList words;
+  for (int row = first; row < m_songs->size(); ++row)
+    words << completionWords(row);
+  m_completionModel->addWords(words);
+}
 
-bool CLibrary::parseSong(const QString &path, Song &song)
+void CLibrary::removeSongs(QList< int > rows)
+{
+  if (rows.isEmpty())
+    return;
+
+  // remove the rows from the end by contiguous ranges, the path index
+  // and the search indexes are updated once all the ranges are gone
+  QStringList words;
+  qSort(rows.begin(), rows.end(), qGreater< int >());
+  m_songs->beginRemove();
+  for (int i = 0; i < rows.size(); )
+    {
+      int last = rows[i];
+      int first = last;
+      while (++i < rows.size() && rows[i] == first - 1)
+	first = rows[i];
+
+      beginRemoveRows(QModelIndex(), first, last);
+      for (int row = first; row <= last; ++row)
+	{
+	  m_rows.remove(m_songs->path(row));
+	  words << completionWords(row);
+	}
+      m_songs->remove(first, last - first + 1);
+      endRemoveRows();
+    }
+  m_songs->endRemove();
+  updateRows(rows.last());
+  m_completionModel->removeWords(words);
+  unwatchUnusedCovers();
+}
+
+bool CLibrary::removeRows(int row, int count, const QModelIndex &parent)
+{
+  if (parent.isValid() || row < 0 || count <= 0 || row + count > m_songs->size())
+    return false;
+
+  QStringList words;
+  beginRemoveRows(parent, row, row + count - 1);
+  for (int i = row; i < row + count; ++i)
+    {
+      m_rows.remove(m_songs->path(i));
+      words << completionWords(i);
+    }
+  m_songs->remove(row, count);
+  endRemoveRows();
+
+  updateRows(row);
+  m_completionModel->removeWords(words);
+  unwatchUnusedCovers();
+  return true;
+}
+
+void CLibrary::updateRows(int first)
+{
+  for (int i = first; i < m_songs->size(); ++i)
+    m_rows[m_songs->path(i)] = i;
+}
+
+void CLibrary::addSongs(const QStringList &paths)
+{
+  loadSongs(paths);
+}
+
+bool CLibrary::parseSong(const QString &path, Song &song, bool lyrics)
 {
   QFile file(path);
 
-  if (!file.open(QIODevice::ReadOnly | QIODevice::Text))
+  if (!file.open(QIODevice::ReadOnly))
     {
       qWarning() << "CLibrary::parseSong: unable to open " << path;
       return false;
     }
 
-  QTextStream stream (&file);
-  stream.setCodec("UTF-8");
-  QString fileStr = stream.readAll();
-  file.close();
+  // songs are read at once: they are a few kilobytes, and a mapped
+  // file truncated by the editor meanwhile would crash the scan
+  CSongScanner scanner;
+  QByteArray content = file.readAll();
+  scanner.scan(content.constData(), content.size());
+  song.lyrics = lyrics ? lyricsWords(content.constData(), content.size()) : QByteArray();
 
+  QFileInfo info(path);
   song.path = path;
+  song.lastModified = info.lastModified().toTime_t();
+  song.size = file.size();
+  song.title = SbUtils::latexToUtf8(scanner.title());
+  song.artist = SbUtils::latexToUtf8(scanner.artist());
+  song.album = SbUtils::latexToUtf8(scanner.album());
+  song.isLilypond = scanner.isLilypond();
+  song.coverName = scanner.coverName();
+  song.coverPath = info.absolutePath();
+  song.language = languageFromString(scanner.language());
 
-  reSong.indexIn(fileStr);
-  song.title = SbUtils::latexToUtf8(reSong.cap(1));
-
-  reArtist.indexIn(reSong.cap(2));
-  song.artist = SbUtils::latexToUtf8(reArtist.cap(1));
-
-  reAlbum.indexIn(reSong.cap(2));
-  song.album = SbUtils::latexToUtf8(reAlbum.cap(1));
+  file.close();
+  return true;
+}
 
-  song.isLilypond = QBool(reLilypond.indexIn(fileStr) > -1);
+QByteArray CLibrary::lyricsWords(const char *data, qint64 size)
+{
+  // the text is folded like the search keys, LaTeX comments and
+  // command names are skipped while chords are kept as words
+  QString text = SbUtils::foldString(SbUtils::latexToUtf8(QString::fromUtf8(data, size)));
+  QSet< QString > words;
+  int begin = -1;
+  for (int i = 0; i <= text.size(); ++i)
+    {
+      QChar c = i < text.size() ? text[i] : QChar();
+      if (c.isLetterOrNumber())
+	{
+	  if (begin == -1)
+	    begin = i;
+	  continue;
+	}
 
-  reCoverName.indexIn(reSong.cap(2));
-  song.coverName = reCoverName.cap(1);
+      if (begin != -1)
+	words.insert(text.mid(begin, i - begin));
+      begin = -1;
 
-  song.coverPath = QFileInfo(path).absolutePath();
+      if (c == QChar('%'))
+	{
+	  while (i < text.size() && text[i] != QChar('\n'))
+	    ++i;
+	}
+      else if (c == QChar('\\'))
+	{
+	  while (i + 1 < text.size() && text[i + 1].isLetter())
+	    ++i;
+	}
+    }
 
-  reLanguage.indexIn(fileStr);
-  song.language = languageFromString(reLanguage.cap(1));
+  // an empty list still tells that the song has been indexed
+  QStringList list = words.toList();
+  return list.isEmpty() ? QByteArray("", 0) : list.join(" ").toUtf8();
+}
 
-  return true;
+CLibrary::Song CLibrary::loadSong(const QString &path, bool lyrics)
+{
+  Song song;
+  if (!parseSong(path, song, lyrics))
+    song.path = QString();
+  return song;
 }
 
 void CLibrary::addSong(const QString &path)
 {
   Song song;
-  parseSong(path, song);
-  m_songs << song;
+  if (parseSong(path, song, m_lyricsIndexed))
+    insertSongs(QList< Song >() << song);
 }
 
 void CLibrary::removeSong(const QString &path)
 {
-  for (int i = 0; i < m_songs.size(); ++i)
+  QHash< QString, int >::const_iterator it = m_rows.constFind(path);
+  if (it != m_rows.constEnd())
+    removeRows(*it, 1);
+}
+
+void CLibrary::updateSong(const QString &path)
+{
+  Song song;
+  if (!parseSong(path, song, m_lyricsIndexed))
     {
-      if (m_songs[i].path == path)
-	m_songs.removeAt(i);
+      removeSong(path);
+      return;
     }
-  emit(wasModified());
+
+  QHash< QString, int >::const_iterator it = m_rows.constFind(path);
+  if (it == m_rows.constEnd())
+    {
+      insertSongs(QList< Song >() << song);
+      return;
+    }
+
+  replaceSong(*it, song);
 }
 
-void CLibrary::updateSong(const QString &path)
+bool CLibrary::containsSong(const QString &path) const
 {
-  removeSong(path);
-  addSong(path);
-  emit(wasModified());
+  return m_rows.contains(path);
+}
+
+QString CLibrary::indexPath() const
+{
+  QByteArray key = QCryptographicHash::hash(m_canonicalPath.toUtf8(),
+					    QCryptographicHash::Md5).toHex();
+  return QString("%1/library-%2.idx")
+    .arg(QDesktopServices::storageLocation(QDesktopServices::CacheLocation))
+    .arg(QString(key));
 }
 
-bool CLibrary::containsSong(const QString &path)
+bool CLibrary::readIndex(const QString &path, QHash< QString, Song > &index)
 {
-  for (int i = 0; i < m_songs.size(); ++i)
+  QFile file(path);
+  if (!file.open(QIODevice::ReadOnly))
+    return false;
+
+  QDataStream stream(&file);
+  stream.setVersion(QDataStream::Qt_4_6);
+
+  quint32 magic, version;
+  stream >> magic >> version;
+  if (magic != IndexMagic || version != IndexVersion)
     {
-      if (m_songs[i].path == path)
-	return true;
+      qWarning() << "CLibrary::readIndex: ignoring incompatible index " << file.fileName();
+      return false;
     }
-  return false;
+
+  qint32 count;
+  stream >> count;
+  index.reserve(count);
+  for (int i = 0; i < count && stream.status() == QDataStream::Ok; ++i)
+    {
+      Song song;
+      stream >> song;
+      index.insert(song.path, song);
+    }
+
+  if (stream.status() != QDataStream::Ok)
+    {
+      qWarning() << "CLibrary::readIndex: corrupted index " << file.fileName();
+      index.clear();
+      return false;
+    }
+  return true;
+}
+
+bool CLibrary::writeIndex() const
+{
+  QFileInfo info(indexPath());
+  if (!QDir().mkpath(info.absolutePath()))
+    return false;
+
+  QFile file(info.absoluteFilePath());
+  if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate))
+    {
+      qWarning() << "CLibrary::writeIndex: unable to open " << file.fileName();
+      return false;
+    }
+
+  QDataStream stream(&file);
+  stream.setVersion(QDataStream::Qt_4_6);
+  stream << IndexMagic << IndexVersion << qint32(m_songs->size());
+  for (int i = 0; i < m_songs->size(); ++i)
+    stream << m_songs->song(i);
+
+  return stream.status() == QDataStream::Ok;
 }
 
 int CLibrary::rowCount(const QModelIndex &) const
 {
-  return m_songs.size();
+  return m_songs->size();
 }
 
 int CLibrary::columnCount(const QModelIndex &) const
@@ -28,15 +28,23 @@
 
 #include <QAbstractTableModel>
 #include <QString>
+#include <QHash>
+#include <QSet>
 #include <QDir>
 #include <QLocale>
 #include <QMetaType>
+#include <QFutureWatcher>
 
 class QAbstractListModel;
-class QStringListModel;
+class CCompletionModel;
+class CCoverLoader;
+class QFileSystemWatcher;
+class QTimer;
 
 class QPixmap;
+class QSize;
 class CMainWindow;
+class CSongStore;
 
 class CLibrary : public QAbstractTableModel
 {
@@ -67,6 +75,10 @@ public:
     QString coverPath;
     QLocale::Language language;
     bool isLilypond;
+    uint lastModified;
+    qint64 size;
+    // folded distinct words of the file, null when not indexed
+    QByteArray lyrics;
   };
 
   CLibrary(CMainWindow* parent);
@@ -78,6 +90,7 @@ public:
   QString findSongbookPath();
 
   QDir directory() const;
+  QString canonicalPath() const;
   void setDirectory(const QString &directory);
   void setDirectory(const QDir &directory);
 
@@ -91,40 +104,110 @@ public:
   void addSong(const QString &path);
   void addSongs(const QStringList &paths);
   void removeSong(const QString &path);
-  bool containsSong(const QString &path);
+  bool containsSong(const QString &path) const;
+  virtual bool removeRows(int row, int count, const QModelIndex &parent = QModelIndex());
   virtual int rowCount(const QModelIndex &index = QModelIndex()) const;
   virtual int columnCount(const QModelIndex &index = QModelIndex()) const;
 
+  bool isUpdating() const;
+
+  bool isLyricsIndexed() const;
+  void setLyricsIndexed(bool indexed);
+
+  const CSongStore * songs() const;
+  int compare(int leftRow, int rightRow, int column) const;
+
+  void prefetchCover(const QString &path);
+
 public slots:
   void update();
+  void cancelUpdate();
   void updateSong(const QString & path);
   void readSettings();
 
+private slots:
+  void songsDirectoryChanged(const QString &path);
+  void applyPendingChanges();
+
+  void songsListed();
+  void songsLoaded(int begin, int end);
+  void songsScanned();
+  void changedSongsLoaded();
+
+  void coverLoaded(const QString &path);
+  void coverChanged(const QString &path);
+
 signals:
   void wasModified();
+  void updating(bool running);
   void directoryChanged(const QDir &directory);
 
 protected:
+  /// Result of the background walk through the songs directory.
+  struct Listing {
+    QStringList songs;
+    QStringList directories;
+    QHash< QString, Song > index;
+  };
 
-  bool parseSong(const QString &path, Song &song);
+  static Listing listSongs(const QString &path, const QString &indexPath);
+  static bool parseSong(const QString &path, Song &song, bool lyrics = false);
+  static Song loadSong(const QString &path, bool lyrics = false);
+  static QByteArray lyricsWords(const char *data, qint64 size);
+
+  void loadSongs(const QStringList &paths);
+  void insertSongs(const QList< Song > &songs);
+  void removeSongs(QList< int > rows);
+  void updateRows(int first);
+  void replaceSong(int row, const Song &song, bool notify = true);
+  void notifyRowsChanged(QList< int > rows);
+  QStringList completionWords(int row) const;
+
+  QVariant cover(const QModelIndex &index, const QSize &size) const;
+  void updateCovers(const QStringList &directories);
+  void repaintCovers(const QSet< int > &covers);
+  void unwatchCovers(const QStringList &paths);
+  void unwatchUnusedCovers();
+
+  QString indexPath() const;
+  static bool readIndex(const QString &path, QHash< QString, Song > &index);
+  bool writeIndex() const;
 
   static QLocale::Language languageFromString(const QString &languageName = QString());
 
-  static QRegExp reSong;
-  static QRegExp reArtist;
-  static QRegExp reAlbum;
-  static QRegExp reCoverName;
-  static QRegExp reLilypond;
-  static QRegExp reLanguage;
-
 private:
+  class SongLoader;
+
+  static const int ScanChunkSize = 256;
+
   CMainWindow *m_parent;
   QDir m_directory;
+  QString m_canonicalPath;
+
+  CCompletionModel *m_completionModel;
 
-  QStringListModel *m_completionModel;
+  CCoverLoader *m_coverLoader;
+  mutable QHash< QString, QList< QPersistentModelIndex > > m_coverRequests;
 
   QStringList m_templates;
-  QList< Song > m_songs;
+  bool m_lyricsIndexed;
+  CSongStore *m_songs;
+  QHash< QString, int > m_rows;
+
+  QFileSystemWatcher *m_watcher;
+  QTimer *m_watcherTimer;
+  QSet< QString > m_pendingDirectories;
+  QSet< QString > m_watchedCovers;
+
+  QFutureWatcher< Listing > *m_listingWatcher;
+  QFutureWatcher< Song > *m_scanWatcher;
+  QList< Song > m_scanBuffer;
+  QSet< QString > m_scanSeen;
+  bool m_scanReplacesAll;
+
+  QFutureWatcher< Song > *m_changeWatcher;
+  QStringList m_changedPaths;
+  QStringList m_queuedPaths;
 };
 
 Q_DECLARE_METATYPE(QLocale::Language)
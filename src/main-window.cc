@@ -270,6 +270,13 @@ void CMainWindow::createActions()
   m_libraryUpdateAct->setShortcut(QKeySequence::Refresh);
   connect(m_libraryUpdateAct, SIGNAL(triggered()), library(), SLOT(update()));
 
+  m_libraryCancelUpdateAct = new QAction(tr("Cancel update"), this);
+  m_libraryCancelUpdateAct->setStatusTip(tr("Stop the update of the song list"));
+  m_libraryCancelUpdateAct->setEnabled(false);
+  connect(m_libraryCancelUpdateAct, SIGNAL(triggered()), library(), SLOT(cancelUpdate()));
+  connect(library(), SIGNAL(updating(bool)),
+	  m_libraryCancelUpdateAct, SLOT(setEnabled(bool)));
+
   m_libraryDownloadAct = new QAction(tr("Download"), this);
   m_libraryDownloadAct->setStatusTip(tr("Download songs from remote location"));
   m_libraryDownloadAct->setIcon(QIcon::fromTheme("folder-remote", QIcon(":/icons/tango/32x32/places/folder-remote.png")));
@@ -363,6 +370,7 @@ void CMainWindow::createMenus()
   libraryMenu->addSeparator();
   libraryMenu->addAction(m_libraryDownloadAct);
   libraryMenu->addAction(m_libraryUpdateAct);
+  libraryMenu->addAction(m_libraryCancelUpdateAct);
 
   m_editorMenu = menuBar()->addMenu(tr("&Editor"));
   CSongEditor *editor = new CSongEditor();
@@ -395,6 +403,7 @@ void CMainWindow::createToolBar()
   QCompleter *completer = new QCompleter;
   completer->setModel(library()->completionModel());
   completer->setCaseSensitivity(Qt::CaseInsensitive);
+  completer->setModelSorting(QCompleter::CaseInsensitivelySortedModel);
   completer->setCompletionMode(QCompleter::PopupCompletion);
 
   m_filterLineEdit = new CFilterLineEdit;
@@ -533,6 +542,12 @@ void CMainWindow::open()
                                                   tr("Songbook (*.sb)"));
   songbook()->load(filename);
   updateTitle(songbook()->filename());
+
+  QStringList missing = songbook()->unresolvedSongs();
+  if (!missing.isEmpty() && !library()->isUpdating())
+    statusBar()->showMessage(tr("%1 songs of the songbook are missing from the library: %2")
+			     .arg(missing.size())
+			     .arg(missing.join(", ")));
 }
 
 void CMainWindow::save(bool forced)
@@ -573,7 +588,7 @@ void CMainWindow::updateTitle(const QString &filename)
 
 const QString CMainWindow::workingPath()
 {
-  return library()->directory().canonicalPath();
+  return library()->canonicalPath();
 }
 
 QProgressBar * CMainWindow::progressBar() const
@@ -639,6 +654,8 @@ void CMainWindow::songEditor(const QString &path, const QString &title)
 
   connect(editor, SIGNAL(labelChanged(const QString&)),
 	  m_mainWidget, SLOT(changeTabText(const QString&)));
+  connect(editor, SIGNAL(saved(const QString&)),
+	  library(), SLOT(updateSong(const QString&)));
 
   m_mainWidget->addTab(editor);
   m_editors.insert(path, editor);
@@ -235,6 +235,7 @@ private:
   QAction *m_unselectAllAct;
   QAction *m_invertSelectionAct;
   QAction *m_libraryUpdateAct;
+  QAction *m_libraryCancelUpdateAct;
   QAction *m_libraryDownloadAct;
 
   // Editors
@@ -250,6 +250,7 @@ OptionsPage::OptionsPage(ConfigDialog *configDialog)
   : Page(configDialog)
   , m_workingPath(0)
   , m_workingPathValid(0)
+  , m_lyricsIndexCheckBox(0)
   , m_buildCommand(0)
   , m_cleanCommand(0)
   , m_cleanallCommand(0)
@@ -264,6 +265,9 @@ OptionsPage::OptionsPage(ConfigDialog *configDialog)
   connect(m_workingPath, SIGNAL(pathChanged(const QString&)),
           this, SLOT(checkWorkingPath(const QString&)));
 
+  m_lyricsIndexCheckBox = new QCheckBox(tr("Index song lyrics"));
+  m_lyricsIndexCheckBox->setToolTip(tr("Allows searching the lyrics with \"lyrics:\" in the filter"));
+
   m_buildCommand = new QLineEdit(this);
   m_cleanCommand = new QLineEdit(this);
   m_cleanallCommand = new QLineEdit(this);
@@ -279,6 +283,7 @@ OptionsPage::OptionsPage(ConfigDialog *configDialog)
   QLayout *workingPathLayout = new QVBoxLayout;
   workingPathLayout->addWidget(m_workingPath);
   workingPathLayout->addWidget(m_workingPathValid);
+  workingPathLayout->addWidget(m_lyricsIndexCheckBox);
   workingPathGroupBox->setLayout(workingPathLayout);
 
   // external tools
@@ -320,6 +325,7 @@ void OptionsPage::readSettings()
   QSettings settings;
   settings.beginGroup("library");
   m_workingPath->setPath(settings.value("workingPath", QDir::homePath()).toString());
+  m_lyricsIndexCheckBox->setChecked(settings.value("lyricsIndex", false).toBool());
   settings.endGroup();
 
   settings.beginGroup("tools");
@@ -334,6 +340,7 @@ void OptionsPage::writeSettings()
   QSettings settings;
   settings.beginGroup("library");
   settings.setValue("workingPath", m_workingPath->path());
+  settings.setValue("lyricsIndex", m_lyricsIndexCheckBox->isChecked());
   settings.endGroup();
 
   settings.beginGroup("tools");
@@ -149,6 +149,7 @@ private:
 
   CFileChooser *m_workingPath;
   QLabel *m_workingPathValid;
+  QCheckBox *m_lyricsIndexCheckBox;
 
   QLineEdit *m_buildCommand;
   QLineEdit *m_cleanCommand;
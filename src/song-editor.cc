@@ -268,6 +268,7 @@ void CSongEditor::save()
       document()->setModified(false);
       setWindowTitle(windowTitle().remove(" *"));
       emit(labelChanged(windowTitle()));
+      emit(saved(path()));
     }
   else
     {
@@ -61,6 +61,7 @@ public:
 signals:
   void labelChanged(const QString &label);
   void wordAdded(const QString &word);
+  void saved(const QString &path);
 
 private slots:
   //write modifications of the textEdit into sg file.
@@ -100,13 +100,14 @@ void CSongItemDelegate::paint(QPainter *painter, const QStyleOptionViewItem &opt
     case 4:
       {
 
-        // draw the cover
+        // draw the cover, the placeholder stands for the covers that
+        // are missing or still being loaded
         QPixmap pixmap;
-        QPixmapCache::find("cover-missing-small", &pixmap);
-        if (qVariantCanConvert< QPixmap >(index.model()->data(index, CLibrary::CoverSmallRole)))
-          {
-            pixmap = qVariantValue< QPixmap >(index.model()->data(index, CLibrary::CoverSmallRole));
-          }
+        QVariant cover = index.model()->data(index, CLibrary::CoverSmallRole);
+        if (qVariantCanConvert< QPixmap >(cover))
+          pixmap = qVariantValue< QPixmap >(cover);
+        else
+          QPixmapCache::find("cover-missing-small", &pixmap);
         QRect coverRectangle(opt.rect.left(), opt.rect.top() + 2,
                              32, opt.rect.height() - 4);
         QApplication::style()->drawItemPixmap(painter,
@@ -70,10 +70,25 @@ QAbstractItemModel * CSongPanel::library() const
 
 void CSongPanel::setLibrary(QAbstractItemModel *library)
 {
+  if (m_library)
+    disconnect(m_library, 0, this, 0);
+
+  // the cover of the song may be loaded after it is displayed
   m_library = library;
+  if (m_library)
+    connect(m_library, SIGNAL(dataChanged(const QModelIndex&, const QModelIndex&)),
+	    SLOT(dataChanged(const QModelIndex&, const QModelIndex&)));
   setCurrentIndex(QModelIndex());
 }
 
+void CSongPanel::dataChanged(const QModelIndex &topLeft, const QModelIndex &bottomRight)
+{
+  if (m_currentIndex.isValid()
+      && m_currentIndex.row() >= topLeft.row()
+      && m_currentIndex.row() <= bottomRight.row())
+    update();
+}
+
 QModelIndex CSongPanel::currentIndex() const
 {
   return m_currentIndex;
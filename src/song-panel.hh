@@ -44,6 +44,9 @@ public slots:
   void setCurrentIndex(const QModelIndex &index);
   void update();
 
+private slots:
+  void dataChanged(const QModelIndex &topLeft, const QModelIndex &bottomRight);
+
 private:
   QAbstractItemModel *m_library;
   QModelIndex m_currentIndex;
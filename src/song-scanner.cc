@@ -0,0 +1,223 @@
+// Copyright (C) 2009-2011, Romain Goffe <romain.goffe@gmail.com>
+// Copyright (C) 2009-2011, Alexandre Dupas <alexandre.dupas@gmail.com>
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License as
+// published by the Free Software Foundation; either version 2 of the
+// License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+// 02110-1301, USA.
+//******************************************************************************
+#include "song-scanner.hh"
+
+#include <cstring>
+
+namespace
+{
+  inline bool isLetter(char c)
+  {
+    return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z');
+  }
+
+  inline bool matches(const char *it, const char *end, const char *word, int size)
+  {
+    return end - it >= size && !std::memcmp(it, word, size);
+  }
+
+  bool contains(const char *it, const char *end, const char *word, int size)
+  {
+    while ((it = static_cast< const char* >(std::memchr(it, word[0], end - it))))
+      {
+	if (matches(it, end, word, size))
+	  return true;
+	++it;
+      }
+    return false;
+  }
+}
+
+const CSongScanner::Field CSongScanner::NoField = { 0, 0 };
+
+CSongScanner::CSongScanner()
+  : m_title(NoField)
+  , m_artist(NoField)
+  , m_album(NoField)
+  , m_coverName(NoField)
+  , m_language(NoField)
+  , m_hasHeader(false)
+  , m_isLilypond(false)
+{}
+
+CSongScanner::~CSongScanner()
+{}
+
+void CSongScanner::scan(const char *data, qint64 size)
+{
+  m_title = m_artist = m_album = m_coverName = m_language = NoField;
+  m_hasHeader = false;
+  m_isLilypond = false;
+
+  const char *it = data;
+  const char *end = data + size;
+  bool body = false;
+  while (it < end && !(m_hasHeader && (body || (m_isLilypond && m_language.size))))
+    {
+      // jump to the next command
+      it = static_cast< const char* >(std::memchr(it, '\\', end - it));
+      if (!it)
+	break;
+
+      const char *name = ++it;
+      while (it < end && isLetter(*it))
+	++it;
+      int length = it - name;
+
+      if (!m_isLilypond && length >= 8 && !std::memcmp(name, "lilypond", 8))
+	m_isLilypond = true;
+      else if (!m_language.size && length == 14 && !std::memcmp(name, "selectlanguage", 14))
+	it = scanLanguage(it, end);
+      else if (!m_hasHeader && length == 9 && !std::memcmp(name, "beginsong", 9))
+	it = scanHeader(it, end, false);
+      else if (!m_hasHeader && length == 5 && !std::memcmp(name, "begin", 5))
+	it = scanHeader(it, end, true);
+      else if (m_hasHeader)
+	body = isBody(name, length, it, end);
+    }
+
+  // the header fields all come before the body, but a score may be
+  // included anywhere in the song
+  if (!m_isLilypond && it)
+    m_isLilypond = contains(it, end, "\\lilypond", 9);
+}
+
+bool CSongScanner::isBody(const char *name, int length, const char *it, const char *end)
+{
+  // \beginverse, \beginchorus, \begin{verse} or \begin{chorus}
+  if (length == 10 && !std::memcmp(name, "beginverse", 10))
+    return true;
+  if (length == 11 && !std::memcmp(name, "beginchorus", 11))
+    return true;
+  return length == 5 && !std::memcmp(name, "begin", 5)
+    && (matches(it, end, "{verse", 6) || matches(it, end, "{chorus", 7));
+}
+
+const char * CSongScanner::scanHeader(const char *it, const char *end, bool environment)
+{
+  // \begin{song}{title}[options] or \beginsong{title}[options]
+  const char *start = it;
+  if (environment)
+    {
+      if (!matches(it, end, "{song", 5))
+	return start;
+      it += 5;
+    }
+  if (it < end && *it == '}')
+    ++it;
+  if (it == end || *it != '{')
+    return start;
+
+  const char *title = ++it;
+  while (it < end && *it != '}' && *it != '[')
+    ++it;
+  if (it == end || *it != '}' || it == title)
+    return start;
+  Field titleField = { title, int(it - title) };
+
+  const char *options = static_cast< const char* >(std::memchr(it, '[', end - it));
+  if (!options)
+    return start;
+  ++options;
+  const char *optionsEnd = static_cast< const char* >(std::memchr(options, ']', end - options));
+  if (!optionsEnd)
+    return start;
+
+  m_title = titleField;
+  m_artist = option(options, optionsEnd, "by=");
+  m_album = option(options, optionsEnd, "album=");
+  m_coverName = option(options, optionsEnd, "cov=");
+  m_hasHeader = true;
+  return optionsEnd + 1;
+}
+
+const char * CSongScanner::scanLanguage(const char *it, const char *end)
+{
+  if (it == end || *it != '{')
+    return it;
+
+  const char *language = ++it;
+  while (it < end && *it != '}')
+    ++it;
+  m_language.begin = language;
+  m_language.size = it - language;
+  return it;
+}
+
+CSongScanner::Field CSongScanner::option(const char *begin, const char *end, const char *key)
+{
+  const int length = std::strlen(key);
+  for (const char *it = begin; end - it > length; ++it)
+    {
+      if (std::memcmp(it, key, length))
+	continue;
+
+      const char *value = it + length;
+      const char *valueEnd = value;
+      while (valueEnd < end && *valueEnd != ',')
+	++valueEnd;
+      if (valueEnd > value)
+	{
+	  Field field = { value, int(valueEnd - value) };
+	  return field;
+	}
+    }
+  return NoField;
+}
+
+QString CSongScanner::decode(const Field &field)
+{
+  // files with CRLF line endings are not read in text mode
+  return field.size ? QString::fromUtf8(field.begin, field.size).remove(QChar('\r')) : QString();
+}
+
+bool CSongScanner::hasHeader() const
+{
+  return m_hasHeader;
+}
+
+QString CSongScanner::title() const
+{
+  return decode(m_title);
+}
+
+QString CSongScanner::artist() const
+{
+  return decode(m_artist);
+}
+
+QString CSongScanner::album() const
+{
+  return decode(m_album);
+}
+
+QString CSongScanner::coverName() const
+{
+  return decode(m_coverName);
+}
+
+QString CSongScanner::language() const
+{
+  return decode(m_language);
+}
+
+bool CSongScanner::isLilypond() const
+{
+  return m_isLilypond;
+}
@@ -0,0 +1,83 @@
+// Copyright (C) 2009-2011, Romain Goffe <romain.goffe@gmail.com>
+// Copyright (C) 2009-2011, Alexandre Dupas <alexandre.dupas@gmail.com>
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License as
+// published by the Free Software Foundation; either version 2 of the
+// License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+// 02110-1301, USA.
+//******************************************************************************
+
+/**
+ * \file song-scanner.hh
+ *
+ * Single-pass scanner for the metadata of a song file.
+ *
+ */
+#ifndef __SONG_SCANNER_HH__
+#define __SONG_SCANNER_HH__
+
+#include <QString>
+
+/**
+ * \class CSongScanner
+ *
+ * Extracts the title, artist, album, cover, language and lilypond
+ * flag of a song in one sweep over the raw UTF-8 content of a .sg
+ * file. The scan stops as soon as all the metadata has been found,
+ * or once the header is known and the first verse or chorus begins;
+ * the rest of the song is then only searched for a lilypond score.
+ *
+ * The scanner has no shared state and can be used on worker threads.
+ * Extracted fields refer to the scanned buffer, which must outlive the
+ * calls to the getters.
+ */
+class CSongScanner
+{
+public:
+  CSongScanner();
+  ~CSongScanner();
+
+  void scan(const char *data, qint64 size);
+
+  bool hasHeader() const;
+  QString title() const;
+  QString artist() const;
+  QString album() const;
+  QString coverName() const;
+  QString language() const;
+  bool isLilypond() const;
+
+private:
+  struct Field {
+    const char *begin;
+    int size;
+  };
+
+  const char * scanHeader(const char *it, const char *end, bool environment);
+  const char * scanLanguage(const char *it, const char *end);
+  static bool isBody(const char *name, int length, const char *it, const char *end);
+  static const Field NoField;
+
+  static Field option(const char *begin, const char *end, const char *key);
+  static QString decode(const Field &field);
+
+  Field m_title;
+  Field m_artist;
+  Field m_album;
+  Field m_coverName;
+  Field m_language;
+  bool m_hasHeader;
+  bool m_isLilypond;
+};
+
+#endif // __SONG_SCANNER_HH__
@@ -0,0 +1,177 @@
+// Copyright (C) 2009-2011, Romain Goffe <romain.goffe@gmail.com>
+// Copyright (C) 2009-2011, Alexandre Dupas <alexandre.dupas@gmail.com>
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License as
+// published by the Free Software Foundation; either version 2 of the
+// License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+// 02110-1301, USA.
+//******************************************************************************
+#include "song-selection.hh"
+
+namespace
+{
+  const int WordBits = 32;
+
+  inline int wordCount(int bits)
+  {
+    return (bits + WordBits - 1) / WordBits;
+  }
+}
+
+CSongSelection::CSongSelection()
+  : m_words()
+  , m_size(0)
+  , m_count(0)
+{}
+
+CSongSelection::~CSongSelection()
+{}
+
+int CSongSelection::size() const
+{
+  return m_size;
+}
+
+int CSongSelection::count() const
+{
+  return m_count;
+}
+
+bool CSongSelection::isEmpty() const
+{
+  return m_size == 0;
+}
+
+bool CSongSelection::testBit(int i) const
+{
+  return m_words[i / WordBits] & (1u << (i % WordBits));
+}
+
+bool CSongSelection::setBit(int i, bool value)
+{
+  if (testBit(i) == value)
+    return false;
+
+  assign(i, value);
+  m_count += value ? 1 : -1;
+  return true;
+}
+
+int CSongSelection::nextSetBit(int from) const
+{
+  if (from >= m_size)
+    return -1;
+
+  // empty words are skipped whole
+  int w = from / WordBits;
+  quint32 word = m_words[w] & (~0u << (from % WordBits));
+  while (word == 0)
+    {
+      if (++w == m_words.size())
+	return -1;
+      word = m_words[w];
+    }
+
+  int bit = 0;
+  while (!(word & 1u))
+    {
+      word >>= 1;
+      ++bit;
+    }
+  return w * WordBits + bit;
+}
+
+void CSongSelection::fill(bool value)
+{
+  m_words.fill(value ? ~0u : 0u);
+  clearPadding();
+  m_count = value ? m_size : 0;
+}
+
+void CSongSelection::invert()
+{
+  for (int i = 0; i < m_words.size(); ++i)
+    m_words[i] = ~m_words[i];
+  clearPadding();
+  m_count = m_size - m_count;
+}
+
+void CSongSelection::insert(int pos, int count, bool value)
+{
+  if (count <= 0)
+    return;
+
+  int oldSize = m_size;
+  int oldWords = m_words.size();
+  m_size += count;
+  m_words.resize(wordCount(m_size));
+  for (int i = oldWords; i < m_words.size(); ++i)
+    m_words[i] = 0;
+
+  // rows are mostly appended, in which case nothing has to move
+  for (int i = oldSize - 1; i >= pos; --i)
+    assign(i + count, testBit(i));
+  for (int i = pos; i < pos + count; ++i)
+    assign(i, value);
+
+  if (value)
+    m_count += count;
+}
+
+void CSongSelection::remove(int pos, int count)
+{
+  if (count <= 0)
+    return;
+
+  for (int i = pos + count; i < m_size; ++i)
+    assign(i - count, testBit(i));
+
+  m_size -= count;
+  m_words.resize(wordCount(m_size));
+  clearPadding();
+
+  m_count = 0;
+  for (int i = 0; i < m_words.size(); ++i)
+    m_count += popCount(m_words[i]);
+}
+
+void CSongSelection::clear()
+{
+  m_words.clear();
+  m_size = 0;
+  m_count = 0;
+}
+
+int CSongSelection::popCount(quint32 word)
+{
+  word = word - ((word >> 1) & 0x55555555);
+  word = (word & 0x33333333) + ((word >> 2) & 0x33333333);
+  return (((word + (word >> 4)) & 0x0f0f0f0f) * 0x01010101) >> 24;
+}
+
+void CSongSelection::assign(int i, bool value)
+{
+  if (value)
+    m_words[i / WordBits] |= (1u << (i % WordBits));
+  else
+    m_words[i / WordBits] &= ~(1u << (i % WordBits));
+}
+
+void CSongSelection::clearPadding()
+{
+  // bits past the last row stay cleared so that bulk operations can
+  // work on whole words
+  int used = m_size % WordBits;
+  if (used != 0)
+    m_words.last() &= (1u << used) - 1;
+}
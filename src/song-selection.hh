@@ -0,0 +1,72 @@
+// Copyright (C) 2009-2011, Romain Goffe <romain.goffe@gmail.com>
+// Copyright (C) 2009-2011, Alexandre Dupas <alexandre.dupas@gmail.com>
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License as
+// published by the Free Software Foundation; either version 2 of the
+// License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+// 02110-1301, USA.
+//******************************************************************************
+
+/**
+ * \file song-selection.hh
+ *
+ * Packed selection state of the songs of a songbook.
+ *
+ */
+#ifndef __SONG_SELECTION_HH__
+#define __SONG_SELECTION_HH__
+
+#include <QVector>
+
+/**
+ * \class CSongSelection
+ *
+ * Bitset with one bit per library row.
+ *
+ * The number of selected rows is maintained along the updates so that
+ * count() is constant time, and bulk operations work a whole word at
+ * a time.
+ */
+class CSongSelection
+{
+public:
+  CSongSelection();
+  ~CSongSelection();
+
+  int size() const;
+  int count() const;
+  bool isEmpty() const;
+
+  bool testBit(int i) const;
+  bool setBit(int i, bool value);
+  int nextSetBit(int from) const;
+
+  void fill(bool value);
+  void invert();
+
+  void insert(int pos, int count, bool value = false);
+  void remove(int pos, int count);
+  void clear();
+
+private:
+  static int popCount(quint32 word);
+
+  void assign(int i, bool value);
+  void clearPadding();
+
+  QVector< quint32 > m_words;
+  int m_size;
+  int m_count;
+};
+
+#endif // __SONG_SELECTION_HH__
@@ -20,21 +20,206 @@
 
 #include "library.hh"
 #include "songbook.hh"
+#include "song-store.hh"
+#include "utils/utils.hh"
+
+#include <QtConcurrentRun>
 
 #include <QDebug>
 
+namespace
+{
+  // beyond this number of rows leaving a refined filter, all the rows
+  // are filtered again
+  const int RefilterThreshold = 256;
+
+  // the rest of the filter string after this word is searched in the
+  // lyrics of the songs
+  const char *LyricsPrefix = "(^|\\s)lyrics:";
+}
+
 CSongSortFilterProxyModel::CSongSortFilterProxyModel(QObject *parent)
   : QSortFilterProxyModel(parent)
   , m_filterString()
   , m_languageFilter()
   , m_negativeLanguageFilter()
   , m_keywordFilter()
-{}
+  , m_positiveKeywords()
+  , m_negativeKeywords()
+  , m_lyricsKeywords()
+  , m_library(0)
+  , m_matches()
+  , m_relevance()
+  , m_matchesGeneration(0)
+  , m_matchesValid(false)
+  , m_fuzzyMatching(false)
+  , m_sortByRelevance(false)
+  , m_backgroundFiltering(false)
+  , m_matchWatcher(new QFutureWatcher< Matches >(this))
+  , m_filterSerial(new QAtomicInt(0))
+  , m_pendingFilterString()
+  , m_pendingGeneration(0)
+  , m_pendingSerial(-1)
+{
+  connect(m_matchWatcher, SIGNAL(finished()), SLOT(matchesComputed()));
+}
 
 CSongSortFilterProxyModel::~CSongSortFilterProxyModel()
-{}
+{
+  // the workers share the serial of the filter, the stale queries
+  // still running give up at their next keyword
+  m_filterSerial->ref();
+  m_matchWatcher->waitForFinished();
+}
+
+bool CSongSortFilterProxyModel::isBackgroundFiltering() const
+{
+  return m_backgroundFiltering;
+}
+
+void CSongSortFilterProxyModel::setBackgroundFiltering(bool enabled)
+{
+  m_backgroundFiltering = enabled;
+}
+
+bool CSongSortFilterProxyModel::isFuzzyMatching() const
+{
+  return m_fuzzyMatching;
+}
+
+void CSongSortFilterProxyModel::setFuzzyMatching(bool enabled)
+{
+  if (m_fuzzyMatching == enabled)
+    return;
+
+  m_fuzzyMatching = enabled;
+  refilter();
+}
+
+bool CSongSortFilterProxyModel::isSortedByRelevance() const
+{
+  return m_sortByRelevance;
+}
+
+void CSongSortFilterProxyModel::setSortByRelevance(bool enabled)
+{
+  if (m_sortByRelevance == enabled)
+    return;
+
+  m_sortByRelevance = enabled;
+  refilter();
+  if (!enabled)
+    invalidate();
+}
+
+void CSongSortFilterProxyModel::refilter()
+{
+  // a query still computed in the background is the latest one
+  m_matchesValid = false;
+  if (m_pendingSerial == *m_filterSerial)
+    setFilterString(m_pendingFilterString);
+  else
+    setFilterString(m_filterString);
+}
 
 void CSongSortFilterProxyModel::setFilterString(const QString &filterString)
+{
+  // any query still computed in the background is now stale
+  m_filterSerial->ref();
+
+  QStringList keywords;
+  QStringList positives;
+  QStringList negatives;
+  QStringList lyrics;
+  parseKeywords(filterString, keywords, positives, negatives, lyrics);
+
+  // a narrower query only needs to re-test the rows that matched,
+  // which is cheap enough to be done at once
+  bool narrowing = isRefinable(positives, negatives, lyrics);
+
+  if (!narrowing && m_backgroundFiltering && m_library)
+    {
+      // the matches are computed against a snapshot of the library
+      // while the current filter stays in place
+      if (!positives.isEmpty() || !negatives.isEmpty() || !lyrics.isEmpty())
+	{
+	  MatchQuery query = matchQuery(positives, negatives, lyrics);
+	  query.serial = *m_filterSerial;
+	  query.currentSerial = m_filterSerial;
+
+	  m_pendingFilterString = filterString;
+	  m_pendingGeneration = m_library->songs()->generation();
+	  m_pendingSerial = query.serial;
+	  m_matchWatcher->setFuture(QtConcurrent::run(&CSongSortFilterProxyModel::computeMatches, query));
+	  return;
+	}
+    }
+
+  QSet< QLocale::Language > languages = m_languageFilter;
+  QSet< QLocale::Language > negativeLanguages = m_negativeLanguageFilter;
+  applyFilterString(filterString);
+
+  if (!narrowing)
+    {
+      m_matchesValid = false;
+      applyFilter();
+      return;
+    }
+
+  // rather than filtering every row again, only the few rows that do
+  // not match anymore are filtered again
+  QList< int > removed = refineMatches();
+  if (removed.size() > RefilterThreshold || !dynamicSortFilter()
+      || languages != m_languageFilter || negativeLanguages != m_negativeLanguageFilter
+      || !refilterRows(removed))
+    applyFilter();
+}
+
+bool CSongSortFilterProxyModel::refilterRows(QList< int > rows)
+{
+  // QSortFilterProxyModel only filters some rows again when the source
+  // reports them as changed; its handler is called directly, once per
+  // run of consecutive rows, so that the other views of the songbook
+  // are not notified
+  qSort(rows);
+  int i = 0;
+  while (i < rows.size())
+    {
+      int first = rows[i];
+      int last = first;
+      while (++i < rows.size() && rows[i] <= last + 1)
+	last = rows[i];
+      if (!QMetaObject::invokeMethod(this, "_q_sourceDataChanged", Qt::DirectConnection,
+				     Q_ARG(QModelIndex, sourceModel()->index(first, 0)),
+				     Q_ARG(QModelIndex, sourceModel()->index(last, 0))))
+	return false;
+    }
+  return true;
+}
+
+bool CSongSortFilterProxyModel::isRefinable(const QStringList &positives, const QStringList &negatives,
+					    const QStringList &lyrics) const
+{
+  // rows matched approximately, ranked or searched by lyrics that
+  // changed are always matched again; refining the whole library
+  // for a first keyword is left to the background as well
+  return m_matchesValid && m_library && !m_fuzzyMatching && !m_sortByRelevance
+    && !m_positiveKeywords.isEmpty()
+    && m_matchesGeneration == m_library->songs()->generation()
+    && lyrics == m_lyricsKeywords
+    && isNarrowing(m_positiveKeywords, m_negativeKeywords, positives, negatives);
+}
+
+void CSongSortFilterProxyModel::applyFilter()
+{
+  // ranked rows have to be sorted again as well
+  if (m_sortByRelevance)
+    invalidate();
+  else
+    invalidateFilter();
+}
+
+void CSongSortFilterProxyModel::applyFilterString(const QString &filterString)
 {
   m_filterString = filterString;
 
@@ -43,9 +228,10 @@ void CSongSortFilterProxyModel::setFilterString(const QString &filterString)
   clearKeywordFilter();
 
   // parse the :keyword parameters and create the appropriate filter
+  QString filter = m_filterString.left(lyricsPosition(m_filterString));
   QRegExp langFilter("!?:(\\w{2})\\s?");
   int pos = 0;
-  while ((pos = langFilter.indexIn(m_filterString, pos)) != -1)
+  while ((pos = langFilter.indexIn(filter, pos)) != -1)
     {
       QString language = langFilter.cap(1);
       QLocale locale(language);
@@ -60,10 +246,115 @@ void CSongSortFilterProxyModel::setFilterString(const QString &filterString)
       pos += langFilter.matchedLength();
     }
 
-  QString filter = m_filterString;
-  filter.remove(langFilter);
-  m_keywordFilter << filter.split(" ");
-  invalidateFilter();
+  parseKeywords(m_filterString, m_keywordFilter, m_positiveKeywords, m_negativeKeywords,
+		m_lyricsKeywords);
+}
+
+void CSongSortFilterProxyModel::matchesComputed()
+{
+  // a newer query supersedes this result
+  if (m_pendingSerial != *m_filterSerial)
+    return;
+
+  // the filter is switched to the new query at once, the matches are
+  // dropped if the library changed in the meantime
+  applyFilterString(m_pendingFilterString);
+  Matches matches = m_matchWatcher->result();
+  m_matches = matches.rows;
+  m_relevance = matches.relevance;
+  m_matchesGeneration = m_pendingGeneration;
+  m_matchesValid = m_pendingGeneration == m_library->songs()->generation();
+  applyFilter();
+}
+
+int CSongSortFilterProxyModel::lyricsPosition(const QString &filterString)
+{
+  QRegExp prefix(LyricsPrefix, Qt::CaseInsensitive);
+  int pos = prefix.indexIn(filterString);
+  return pos == -1 ? filterString.size() : pos;
+}
+
+void CSongSortFilterProxyModel::parseKeywords(const QString &filterString, QStringList &keywords,
+					      QStringList &positives, QStringList &negatives,
+					      QStringList &lyrics)
+{
+  // the lyrics are indexed by word, whatever the punctuation
+  int pos = lyricsPosition(filterString);
+  QString lyricsFilter = filterString.mid(pos).section(':', 1);
+  lyrics << SbUtils::foldString(lyricsFilter).split(QRegExp("\\W+"), QString::SkipEmptyParts);
+
+  QString filter = filterString.left(pos);
+  filter.remove(QRegExp("!?:(\\w{2})\\s?"));
+  keywords << filter.split(" ");
+
+  // keywords are folded once so that rows are matched against the
+  // search keys of the library as they are
+  foreach (const QString &keyword, keywords)
+    {
+      if (keyword.startsWith("!"))
+	{
+	  QString folded = SbUtils::foldString(keyword.mid(1));
+	  if (!folded.isEmpty())
+	    negatives << folded;
+	}
+      else if (!keyword.isEmpty())
+	{
+	  positives << SbUtils::foldString(keyword);
+	}
+    }
+}
+
+bool CSongSortFilterProxyModel::isNarrowing(const QStringList &oldPositives, const QStringList &oldNegatives,
+					    const QStringList &newPositives, const QStringList &newNegatives)
+{
+  // each former keyword must be implied by a new one
+  foreach (const QString &keyword, oldPositives)
+    {
+      bool implied = false;
+      foreach (const QString &other, newPositives)
+	implied = implied || other.contains(keyword);
+      if (!implied)
+	return false;
+    }
+  foreach (const QString &keyword, oldNegatives)
+    {
+      bool implied = false;
+      foreach (const QString &other, newNegatives)
+	implied = implied || keyword.contains(other);
+      if (!implied)
+	return false;
+    }
+  return true;
+}
+
+QList< int > CSongSortFilterProxyModel::refineMatches()
+{
+  QList< int > removed;
+  for (int row = m_matches.nextSetBit(0); row != -1; row = m_matches.nextSetBit(row + 1))
+    {
+      if (!matchesKeywords(row))
+	{
+	  m_matches.setBit(row, false);
+	  removed << row;
+	}
+    }
+  return removed;
+}
+
+bool CSongSortFilterProxyModel::matchesKeywords(int sourceRow) const
+{
+  const QString &key = m_library->songs()->searchKey(sourceRow);
+  foreach (const QString &keyword, m_positiveKeywords)
+    {
+      if (!key.contains(keyword))
+	return false;
+    }
+  foreach (const QString &keyword, m_negativeKeywords)
+    {
+      if (key.contains(keyword))
+	return false;
+    }
+  return true;
 }
 
 QString CSongSortFilterProxyModel::filterString() const
@@ -71,71 +362,207 @@ QString CSongSortFilterProxyModel::filterString() const
   return m_filterString;
 }
 
+void CSongSortFilterProxyModel::setSourceModel(QAbstractItemModel *sourceModel)
+{
+  // the songbook maps its rows one to one on the library ones
+  CSongbook *songbook = qobject_cast< CSongbook* >(sourceModel);
+  m_library = songbook ? songbook->library() : 0;
+  QSortFilterProxyModel::setSourceModel(sourceModel);
+}
+
 bool CSongSortFilterProxyModel::filterAcceptsRow(int sourceRow, const QModelIndex &sourceParent) const
 {
-  QModelIndex index = sourceModel()->index(sourceRow, 0, sourceParent);
+  if (!m_library)
+    return true;
 
-  bool accept = true;
-  if (!m_keywordFilter.isEmpty())
+  const CSongStore *songs = m_library->songs();
+  if (!m_positiveKeywords.isEmpty() || !m_negativeKeywords.isEmpty()
+      || !m_lyricsKeywords.isEmpty())
     {
-      foreach (QString keyword, m_keywordFilter)
-        {
-          if (keyword.startsWith("!"))
-            {
-              keyword.remove("!");
-              if (sourceModel()->data(index, CLibrary::TitleRole).toString().contains(keyword, Qt::CaseInsensitive)
-                  || sourceModel()->data(index, CLibrary::ArtistRole).toString().contains(keyword, Qt::CaseInsensitive)
-                  || sourceModel()->data(index, CLibrary::AlbumRole).toString().contains(keyword, Qt::CaseInsensitive))
-                {
-                  accept = false;
-                }
-            }
-          else if (!sourceModel()->data(index, CLibrary::TitleRole).toString().contains(keyword, Qt::CaseInsensitive)
-                   && !sourceModel()->data(index, CLibrary::ArtistRole).toString().contains(keyword, Qt::CaseInsensitive)
-                   && !sourceModel()->data(index, CLibrary::AlbumRole).toString().contains(keyword, Qt::CaseInsensitive))
-            {
-              accept = false;
-            }
-        }
+      updateMatches();
+      if (!m_matches.testBit(sourceRow))
+	return false;
     }
 
-  if (!m_negativeLanguageFilter.isEmpty())
-    accept = accept && !m_negativeLanguageFilter.contains(qVariantValue< QLocale::Language >(sourceModel()->data(index, CLibrary::LanguageRole)));
+  if (!m_negativeLanguageFilter.isEmpty()
+      && m_negativeLanguageFilter.contains(songs->language(sourceRow)))
+    return false;
 
-  if (!m_languageFilter.isEmpty())
-    accept = accept && m_languageFilter.contains(qVariantValue< QLocale::Language >(sourceModel()->data(index, CLibrary::LanguageRole)));
+  if (!m_languageFilter.isEmpty()
+      && !m_languageFilter.contains(songs->language(sourceRow)))
+    return false;
 
-  return accept;
+  return true;
 }
 
-void CSongSortFilterProxyModel::checkAll()
+bool CSongSortFilterProxyModel::lessThan(const QModelIndex &left, const QModelIndex &right) const
 {
-  int rows = rowCount();
-  CSongbook *songbook = qobject_cast< CSongbook* >(sourceModel());
-  for (int i = 0; i < rows; ++i)
+  if (m_sortByRelevance && m_library && !m_positiveKeywords.isEmpty())
     {
-      songbook->setChecked(mapToSource(index(i,0)), true);
+      updateMatches();
+      qreal leftRelevance = m_relevance.value(left.row());
+      qreal rightRelevance = m_relevance.value(right.row());
+      if (leftRelevance != rightRelevance)
+	return leftRelevance > rightRelevance;
     }
+
+  if (m_library)
+    return m_library->compare(left.row(), right.row(), left.column()) < 0;
+
+  return QSortFilterProxyModel::lessThan(left, right);
 }
 
-void CSongSortFilterProxyModel::uncheckAll()
+CSongSortFilterProxyModel::MatchQuery
+CSongSortFilterProxyModel::matchQuery(const QStringList &positives, const QStringList &negatives,
+				      const QStringList &lyrics) const
 {
-  int rows = rowCount();
-  CSongbook *songbook = qobject_cast< CSongbook* >(sourceModel());
-  for (int i = 0; i < rows; ++i)
+  const CSongStore *songs = m_library->songs();
+  MatchQuery query;
+  query.index = songs->tokenIndex();
+  query.trigrams = songs->trigramIndex();
+  query.lyricsIndex = songs->lyricsIndex();
+  query.size = songs->size();
+  query.fuzzy = m_fuzzyMatching;
+  query.ranked = m_sortByRelevance;
+  query.positives = positives;
+  query.negatives = negatives;
+  query.lyrics = lyrics;
+  query.serial = 0;
+  query.currentSerial.clear();
+  return query;
+}
+
+void CSongSortFilterProxyModel::updateMatches() const
+{
+  const CSongStore *songs = m_library->songs();
+  if (m_matchesValid && m_matchesGeneration == songs->generation())
+    return;
+
+  Matches matches = computeMatches(matchQuery(m_positiveKeywords, m_negativeKeywords,
+					      m_lyricsKeywords));
+  m_matches = matches.rows;
+  m_relevance = matches.relevance;
+  m_matchesGeneration = songs->generation();
+  m_matchesValid = true;
+}
+
+CSongSortFilterProxyModel::Matches
+CSongSortFilterProxyModel::computeMatches(const MatchQuery &query)
+{
+  // the matching rows are obtained from the inverted index of the
+  // library, starting with the keyword that has the fewest matches;
+  // a query that went stale is given up between two keywords
+  Matches matches;
+  QList< QVector< int > > positives;
+  if (query.fuzzy || query.ranked)
+    matches.relevance.fill(0, query.size);
+
+  foreach (const QString &keyword, query.positives)
+    {
+      if (query.currentSerial && *query.currentSerial != query.serial)
+	return matches;
+
+      QVector< int > exact = query.index.rows(keyword);
+      if (!query.fuzzy && !query.ranked)
+	{
+	  positives << exact;
+	  continue;
+	}
+
+      // approximate matches contain a word within a few edits of the
+      // keyword; the relevance of a row adds up the share of the
+      // trigrams of the keyword it contains, exact matches coming first
+      CSongSelection exactRows;
+      exactRows.insert(0, query.size, false);
+      foreach (int row, exact)
+	exactRows.setBit(row, true);
+
+      QVector< int > rows = query.fuzzy ? query.index.approximateRows(keyword) : exact;
+      QVector< quint64 > trigrams = CTrigramIndex::trigrams(keyword);
+      QVector< int > counts = query.trigrams.count(trigrams, query.size);
+      foreach (int row, rows)
+	{
+	  qreal similarity = trigrams.isEmpty() ? 0 : qreal(counts[row]) / trigrams.size();
+	  matches.relevance[row] += similarity + (exactRows.testBit(row) ? 1 : 0);
+	}
+      positives << rows;
+    }
+
+  // the words of the lyrics must all be found in the song
+  foreach (const QString &word, query.lyrics)
     {
-      songbook->setChecked(mapToSource(index(i,0)), false);
+      if (query.currentSerial && *query.currentSerial != query.serial)
+	return matches;
+      positives << query.lyricsIndex.rows(word);
     }
+
+  if (positives.isEmpty())
+    {
+      matches.rows.insert(0, query.size, true);
+    }
+  else
+    {
+      int smallest = 0;
+      for (int i = 1; i < positives.size(); ++i)
+	{
+	  if (positives[i].size() < positives[smallest].size())
+	    smallest = i;
+	}
+      QVector< int > rows = positives.takeAt(smallest);
+      foreach (const QVector< int > &other, positives)
+	rows = CTokenIndex::intersect(rows, other);
+
+      matches.rows.insert(0, query.size, false);
+      foreach (int row, rows)
+	matches.rows.setBit(row, true);
+    }
+
+  foreach (const QString &keyword, query.negatives)
+    {
+      if (query.currentSerial && *query.currentSerial != query.serial)
+	return matches;
+      foreach (int row, query.index.rows(keyword))
+	matches.rows.setBit(row, false);
+    }
+
+  return matches;
+}
+
+void CSongSortFilterProxyModel::checkAll()
+{
+  CSongbook *songbook = qobject_cast< CSongbook* >(sourceModel());
+  if (rowCount() == songbook->rowCount())
+    songbook->checkAll();
+  else
+    songbook->setRowsChecked(sourceRows(), true);
+}
+
+void CSongSortFilterProxyModel::uncheckAll()
+{
+  CSongbook *songbook = qobject_cast< CSongbook* >(sourceModel());
+  if (rowCount() == songbook->rowCount())
+    songbook->uncheckAll();
+  else
+    songbook->setRowsChecked(sourceRows(), false);
 }
 
 void CSongSortFilterProxyModel::toggleAll()
 {
-  int rows = rowCount();
   CSongbook *songbook = qobject_cast< CSongbook* >(sourceModel());
-  for (int i = 0; i < rows; ++i)
-    {
-      songbook->toggle(mapToSource(index(i,0)));
-    }
+  if (rowCount() == songbook->rowCount())
+    songbook->toggleAll();
+  else
+    songbook->toggleRows(sourceRows());
+}
+
+QList< int > CSongSortFilterProxyModel::sourceRows() const
+{
+  QList< int > rows;
+  int count = rowCount();
+  rows.reserve(count);
+  for (int i = 0; i < count; ++i)
+    rows << mapToSource(index(i,0)).row();
+  return rows;
 }
 
 void CSongSortFilterProxyModel::insertLanguageFilter(const QLocale::Language &language)
@@ -181,6 +608,9 @@ const QSet< QLocale::Language > & CSongSortFilterProxyModel::negativeLanguageFil
 void CSongSortFilterProxyModel::clearKeywordFilter()
 {
   m_keywordFilter.clear();
+  m_positiveKeywords.clear();
+  m_negativeKeywords.clear();
+  m_lyricsKeywords.clear();
 }
 
 const QStringList & CSongSortFilterProxyModel::keywordFilter() const
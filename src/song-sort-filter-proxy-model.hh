@@ -23,6 +23,15 @@
 #include <QSet>
 #include <QLocale>
 #include <QStringList>
+#include <QFutureWatcher>
+#include <QAtomicInt>
+#include <QSharedPointer>
+
+#include "song-selection.hh"
+#include "token-index.hh"
+#include "trigram-index.hh"
+
+class CLibrary;
 
 class CSongSortFilterProxyModel : public QSortFilterProxyModel
 {
@@ -45,6 +54,9 @@ public slots:
 
   void clearKeywordFilter();
 
+  void setFuzzyMatching(bool enabled);
+  void setSortByRelevance(bool enabled);
+
 public:
   CSongSortFilterProxyModel(QObject *parent = 0);
   ~CSongSortFilterProxyModel();
@@ -54,14 +66,91 @@ public:
   const QSet< QLocale::Language > & negativeLanguageFilter() const;
   const QStringList & keywordFilter() const;
 
+  virtual void setSourceModel(QAbstractItemModel *sourceModel);
+
+  bool isBackgroundFiltering() const;
+  void setBackgroundFiltering(bool enabled);
+
+  bool isFuzzyMatching() const;
+  bool isSortedByRelevance() const;
+
 protected:
   bool filterAcceptsRow(int sourceRow, const QModelIndex &sourceParent) const;
+  bool lessThan(const QModelIndex &left, const QModelIndex &right) const;
+
+  QList< int > sourceRows() const;
+
+private slots:
+  void matchesComputed();
+
+private:
+  struct MatchQuery
+  {
+    CTokenIndex index;
+    CTrigramIndex trigrams;
+    CTokenIndex lyricsIndex;
+    int size;
+    bool fuzzy;
+    bool ranked;
+    QStringList positives;
+    QStringList negatives;
+    QStringList lyrics;
+    int serial;
+    QSharedPointer< QAtomicInt > currentSerial;
+  };
+
+  struct Matches
+  {
+    CSongSelection rows;
+    QVector< qreal > relevance;
+  };
+
+  static int lyricsPosition(const QString &filterString);
+  static void parseKeywords(const QString &filterString, QStringList &keywords,
+			    QStringList &positives, QStringList &negatives,
+			    QStringList &lyrics);
+  static Matches computeMatches(const MatchQuery &query);
+  MatchQuery matchQuery(const QStringList &positives, const QStringList &negatives,
+			const QStringList &lyrics) const;
+  void applyFilter();
+  void refilter();
+
+  void applyFilterString(const QString &filterString);
+
+  void updateMatches() const;
+  bool isRefinable(const QStringList &positives, const QStringList &negatives,
+		   const QStringList &lyrics) const;
+  QList< int > refineMatches();
+  bool refilterRows(QList< int > rows);
+  bool matchesKeywords(int sourceRow) const;
+  static bool isNarrowing(const QStringList &oldPositives, const QStringList &oldNegatives,
+			  const QStringList &newPositives, const QStringList &newNegatives);
 
 private:
   QString m_filterString;
   QSet< QLocale::Language > m_languageFilter;
   QSet< QLocale::Language > m_negativeLanguageFilter;
   QStringList m_keywordFilter;
+  QStringList m_positiveKeywords;
+  QStringList m_negativeKeywords;
+  QStringList m_lyricsKeywords;
+
+  CLibrary *m_library;
+
+  mutable CSongSelection m_matches;
+  mutable QVector< qreal > m_relevance;
+  mutable uint m_matchesGeneration;
+  mutable bool m_matchesValid;
+
+  bool m_fuzzyMatching;
+  bool m_sortByRelevance;
+
+  bool m_backgroundFiltering;
+  QFutureWatcher< Matches > *m_matchWatcher;
+  QSharedPointer< QAtomicInt > m_filterSerial;
+  QString m_pendingFilterString;
+  uint m_pendingGeneration;
+  int m_pendingSerial;
 };
 
 #endif // __SONG_SORT_FILTER_PROXY_MODEL_HH__
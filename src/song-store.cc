@@ -0,0 +1,425 @@
+// Copyright (C) 2009-2011, Romain Goffe <romain.goffe@gmail.com>
+// Copyright (C) 2009-2011, Alexandre Dupas <alexandre.dupas@gmail.com>
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License as
+// published by the Free Software Foundation; either version 2 of the
+// License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+// 02110-1301, USA.
+//******************************************************************************
+#include "song-store.hh"
+
+#include "utils/utils.hh"
+
+CSongStore::CSongStore()
+  : m_artists()
+  , m_albums()
+  , m_coverNames()
+  , m_directories()
+  , m_covers()
+  , m_coverNameIds()
+  , m_artistKeys()
+  , m_albumKeys()
+  , m_languageKeys()
+  , m_root()
+  , m_rootPath()
+  , m_tokenIndex()
+  , m_trigramIndex()
+  , m_lyricsIndex()
+  , m_generation(0)
+  , m_removing(false)
+  , m_remainingRows()
+  , m_rowsBeforeRemove(0)
+  , m_titleColumn()
+  , m_titleKeyColumn()
+  , m_pathColumn()
+  , m_pathKeyColumn()
+  , m_relativePathColumn()
+  , m_searchKeyColumn()
+  , m_lyricsColumn()
+  , m_artistColumn()
+  , m_albumColumn()
+  , m_coverColumn()
+  , m_directoryColumn()
+  , m_languageColumn()
+  , m_lilypondColumn()
+  , m_lastModifiedColumn()
+  , m_sizeColumn()
+{}
+
+CSongStore::~CSongStore()
+{}
+
+int CSongStore::size() const
+{
+  return m_pathColumn.size();
+}
+
+bool CSongStore::isEmpty() const
+{
+  return m_pathColumn.isEmpty();
+}
+
+void CSongStore::clear()
+{
+  m_artists.clear();
+  m_albums.clear();
+  m_coverNames.clear();
+  m_directories.clear();
+  m_covers.clear();
+  m_coverNameIds.clear();
+  m_artistKeys.clear();
+  m_albumKeys.clear();
+  m_languageKeys.clear();
+  m_tokenIndex.clear();
+  m_trigramIndex.clear();
+  m_lyricsIndex.clear();
+  ++m_generation;
+
+  m_titleColumn.clear();
+  m_titleKeyColumn.clear();
+  m_pathColumn.clear();
+  m_pathKeyColumn.clear();
+  m_relativePathColumn.clear();
+  m_searchKeyColumn.clear();
+  m_lyricsColumn.clear();
+  m_artistColumn.clear();
+  m_albumColumn.clear();
+  m_coverColumn.clear();
+  m_directoryColumn.clear();
+  m_languageColumn.clear();
+  m_lilypondColumn.clear();
+  m_lastModifiedColumn.clear();
+  m_sizeColumn.clear();
+}
+
+QString CSongStore::rootDirectory() const
+{
+  return m_rootPath;
+}
+
+void CSongStore::setRootDirectory(const QString &path)
+{
+  if (path == m_rootPath)
+    return;
+
+  m_rootPath = path;
+  m_root = QDir(path);
+  for (int row = 0; row < size(); ++row)
+    {
+      m_relativePathColumn[row] = makeRelative(m_pathColumn[row]);
+      m_pathKeyColumn[row] = SbUtils::collationKey(m_relativePathColumn[row]);
+    }
+}
+
+QString CSongStore::makeRelative(const QString &path) const
+{
+  // songs are almost always below the root, which only needs a
+  // prefix comparison
+  int length = m_rootPath.size();
+  if (length > 0 && path.size() > length && path[length] == QChar('/')
+      && path.startsWith(m_rootPath))
+    return path.mid(length + 1);
+
+  return m_root.relativeFilePath(path);
+}
+
+void CSongStore::append(const CLibrary::Song &song)
+{
+  int row = size();
+  m_titleColumn.resize(row + 1);
+  m_titleKeyColumn.resize(row + 1);
+  m_pathColumn.resize(row + 1);
+  m_pathKeyColumn.resize(row + 1);
+  m_relativePathColumn.resize(row + 1);
+  m_searchKeyColumn.resize(row + 1);
+  m_lyricsColumn.resize(row + 1);
+  m_artistColumn.resize(row + 1);
+  m_albumColumn.resize(row + 1);
+  m_coverColumn.resize(row + 1);
+  m_directoryColumn.resize(row + 1);
+  m_languageColumn.resize(row + 1);
+  m_lilypondColumn.resize(row + 1);
+  m_lastModifiedColumn.resize(row + 1);
+  m_sizeColumn.resize(row + 1);
+  set(row, song);
+}
+
+void CSongStore::replace(int row, const CLibrary::Song &song)
+{
+  m_tokenIndex.remove(row, m_searchKeyColumn[row]);
+  m_trigramIndex.remove(row, m_searchKeyColumn[row]);
+  m_lyricsIndex.remove(row, QString::fromUtf8(m_lyricsColumn[row]));
+  set(row, song);
+}
+
+void CSongStore::beginRemove()
+{
+  // the original number of each remaining row is tracked until the
+  // indexes are renumbered, once for all the removed ranges
+  m_removing = true;
+  m_remainingRows.resize(size());
+  for (int row = 0; row < size(); ++row)
+    m_remainingRows[row] = row;
+  m_rowsBeforeRemove = size();
+}
+
+void CSongStore::endRemove()
+{
+  QVector< int > rows(m_rowsBeforeRemove, -1);
+  for (int row = 0; row < m_remainingRows.size(); ++row)
+    rows[m_remainingRows[row]] = row;
+
+  m_tokenIndex.renumberRows(rows);
+  m_trigramIndex.renumberRows(rows);
+  m_lyricsIndex.renumberRows(rows);
+
+  m_removing = false;
+  m_remainingRows.clear();
+}
+
+void CSongStore::remove(int row, int count)
+{
+  if (!m_removing)
+    {
+      beginRemove();
+      remove(row, count);
+      endRemove();
+      return;
+    }
+
+  m_remainingRows.remove(row, count);
+  ++m_generation;
+
+  m_titleColumn.remove(row, count);
+  m_titleKeyColumn.remove(row, count);
+  m_pathColumn.remove(row, count);
+  m_pathKeyColumn.remove(row, count);
+  m_relativePathColumn.remove(row, count);
+  m_searchKeyColumn.remove(row, count);
+  m_lyricsColumn.remove(row, count);
+  m_artistColumn.remove(row, count);
+  m_albumColumn.remove(row, count);
+  m_coverColumn.remove(row, count);
+  m_directoryColumn.remove(row, count);
+  m_languageColumn.remove(row, count);
+  m_lilypondColumn.remove(row, count);
+  m_lastModifiedColumn.remove(row, count);
+  m_sizeColumn.remove(row, count);
+}
+
+void CSongStore::set(int row, const CLibrary::Song &song)
+{
+  m_titleColumn[row] = song.title;
+  m_titleKeyColumn[row] = SbUtils::collationKey(song.title);
+  m_pathColumn[row] = song.path;
+  m_relativePathColumn[row] = makeRelative(song.path);
+  m_pathKeyColumn[row] = SbUtils::collationKey(m_relativePathColumn[row]);
+  // fields are separated by a character that keywords never contain
+  m_searchKeyColumn[row] = SbUtils::foldString(song.title + QChar('\n')
+					       + song.artist + QChar('\n')
+					       + song.album);
+  m_tokenIndex.insert(row, m_searchKeyColumn[row]);
+  m_trigramIndex.insert(row, m_searchKeyColumn[row]);
+  m_lyricsColumn[row] = song.lyrics;
+  if (!song.lyrics.isEmpty())
+    m_lyricsIndex.insert(row, QString::fromUtf8(song.lyrics));
+  ++m_generation;
+  m_artistColumn[row] = m_artists.intern(song.artist);
+  if (m_artistColumn[row] == m_artistKeys.size())
+    m_artistKeys << SbUtils::collationKey(song.artist);
+  m_albumColumn[row] = m_albums.intern(song.album);
+  if (m_albumColumn[row] == m_albumKeys.size())
+    m_albumKeys << SbUtils::collationKey(song.album);
+  m_coverColumn[row] = m_covers.intern(QString("%1/%2.jpg").arg(song.coverPath).arg(song.coverName));
+  if (m_coverColumn[row] == m_coverNameIds.size())
+    m_coverNameIds << m_coverNames.intern(song.coverName);
+  m_directoryColumn[row] = m_directories.intern(song.coverPath);
+  m_languageColumn[row] = song.language;
+  if (!m_languageKeys.contains(song.language))
+    m_languageKeys.insert(song.language, SbUtils::collationKey(QLocale::languageToString(song.language)));
+  m_lilypondColumn[row] = song.isLilypond;
+  m_lastModifiedColumn[row] = song.lastModified;
+  m_sizeColumn[row] = song.size;
+}
+
+CLibrary::Song CSongStore::song(int row) const
+{
+  CLibrary::Song song;
+  song.title = title(row);
+  song.artist = artist(row);
+  song.album = album(row);
+  song.path = path(row);
+  song.coverName = coverName(row);
+  song.coverPath = directory(row);
+  song.language = language(row);
+  song.isLilypond = isLilypond(row);
+  song.lastModified = lastModified(row);
+  song.size = fileSize(row);
+  song.lyrics = lyrics(row);
+  return song;
+}
+
+const QString & CSongStore::title(int row) const
+{
+  return m_titleColumn[row];
+}
+
+const QString & CSongStore::artist(int row) const
+{
+  return m_artists.at(m_artistColumn[row]);
+}
+
+const QString & CSongStore::album(int row) const
+{
+  return m_albums.at(m_albumColumn[row]);
+}
+
+const QString & CSongStore::path(int row) const
+{
+  return m_pathColumn[row];
+}
+
+const QString & CSongStore::relativePath(int row) const
+{
+  return m_relativePathColumn[row];
+}
+
+const QString & CSongStore::searchKey(int row) const
+{
+  return m_searchKeyColumn[row];
+}
+
+const QByteArray & CSongStore::lyrics(int row) const
+{
+  return m_lyricsColumn[row];
+}
+
+const QByteArray & CSongStore::titleKey(int row) const
+{
+  return m_titleKeyColumn[row];
+}
+
+const QByteArray & CSongStore::artistKey(int row) const
+{
+  return m_artistKeys[m_artistColumn[row]];
+}
+
+const QByteArray & CSongStore::albumKey(int row) const
+{
+  return m_albumKeys[m_albumColumn[row]];
+}
+
+const QByteArray & CSongStore::pathKey(int row) const
+{
+  return m_pathKeyColumn[row];
+}
+
+const QByteArray & CSongStore::languageKey(int row) const
+{
+  return *m_languageKeys.constFind(m_languageColumn[row]);
+}
+
+const QString & CSongStore::directory(int row) const
+{
+  return m_directories.at(m_directoryColumn[row]);
+}
+
+const QString & CSongStore::coverName(int row) const
+{
+  return m_coverNames.at(m_coverNameIds[m_coverColumn[row]]);
+}
+
+const QString & CSongStore::cover(int row) const
+{
+  return m_covers.at(m_coverColumn[row]);
+}
+
+QLocale::Language CSongStore::language(int row) const
+{
+  return m_languageColumn[row];
+}
+
+bool CSongStore::isLilypond(int row) const
+{
+  return m_lilypondColumn[row];
+}
+
+uint CSongStore::lastModified(int row) const
+{
+  return m_lastModifiedColumn[row];
+}
+
+qint64 CSongStore::fileSize(int row) const
+{
+  return m_sizeColumn[row];
+}
+
+int CSongStore::artistId(int row) const
+{
+  return m_artistColumn[row];
+}
+
+int CSongStore::albumId(int row) const
+{
+  return m_albumColumn[row];
+}
+
+int CSongStore::directoryId(int row) const
+{
+  return m_directoryColumn[row];
+}
+
+int CSongStore::coverId(int row) const
+{
+  return m_coverColumn[row];
+}
+
+const CStringPool & CSongStore::artists() const
+{
+  return m_artists;
+}
+
+const CStringPool & CSongStore::albums() const
+{
+  return m_albums;
+}
+
+const CStringPool & CSongStore::directories() const
+{
+  return m_directories;
+}
+
+const CStringPool & CSongStore::covers() const
+{
+  return m_covers;
+}
+
+const CTokenIndex & CSongStore::tokenIndex() const
+{
+  return m_tokenIndex;
+}
+
+const CTrigramIndex & CSongStore::trigramIndex() const
+{
+  return m_trigramIndex;
+}
+
+const CTokenIndex & CSongStore::lyricsIndex() const
+{
+  return m_lyricsIndex;
+}
+
+uint CSongStore::generation() const
+{
+  return m_generation;
+}
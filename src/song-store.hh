@@ -0,0 +1,167 @@
+// Copyright (C) 2009-2011, Romain Goffe <romain.goffe@gmail.com>
+// Copyright (C) 2009-2011, Alexandre Dupas <alexandre.dupas@gmail.com>
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License as
+// published by the Free Software Foundation; either version 2 of the
+// License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+// 02110-1301, USA.
+//******************************************************************************
+
+/**
+ * \file song-store.hh
+ *
+ * Compact storage for the songs of the library.
+ *
+ */
+#ifndef __SONG_STORE_HH__
+#define __SONG_STORE_HH__
+
+#include <QString>
+#include <QDir>
+#include <QVector>
+#include <QHash>
+
+#include "library.hh"
+#include "string-pool.hh"
+#include "token-index.hh"
+#include "trigram-index.hh"
+
+/**
+ * \class CSongStore
+ *
+ * Struct-of-arrays storage for the songs of the library.
+ *
+ * Artists, albums, cover names and directories repeat heavily across
+ * a library: they are interned and each song only refers to them by
+ * identifier. Every column is kept in its own contiguous array.
+ *
+ * Covers are shared by the songs of an album: the path of each cover
+ * is stored once in a table of covers that songs refer to, along with
+ * the cover name written to the index. The directory of each song is
+ * kept to find the songs of a directory that changed on disk.
+ *
+ * The path of each song relative to the songs directory and the key
+ * used to search it are computed once when the song is stored, and
+ * the words of the search keys are kept in an inverted index and a
+ * trigram index. When the library indexes lyrics, their words have
+ * an inverted index of their own.
+ *
+ * Titles, artists and albums have a collation key, computed once per
+ * distinct value, so that sorting them only compares bytes.
+ *
+ * Rows removed between beginRemove() and endRemove() leave the
+ * indexes untouched until endRemove(), which renumbers them once for
+ * all the removed ranges; songs must not be added or replaced
+ * meanwhile.
+ *
+ * The generation number changes whenever the songs do.
+ */
+class CSongStore
+{
+public:
+  CSongStore();
+  ~CSongStore();
+
+  int size() const;
+  bool isEmpty() const;
+  void clear();
+
+  QString rootDirectory() const;
+  void setRootDirectory(const QString &path);
+
+  void append(const CLibrary::Song &song);
+  void replace(int row, const CLibrary::Song &song);
+  void remove(int row, int count);
+  void beginRemove();
+  void endRemove();
+
+  CLibrary::Song song(int row) const;
+
+  const QString & title(int row) const;
+  const QString & artist(int row) const;
+  const QString & album(int row) const;
+  const QString & path(int row) const;
+  const QString & relativePath(int row) const;
+  const QString & searchKey(int row) const;
+  const QByteArray & lyrics(int row) const;
+  const QByteArray & titleKey(int row) const;
+  const QByteArray & artistKey(int row) const;
+  const QByteArray & albumKey(int row) const;
+  const QByteArray & pathKey(int row) const;
+  const QByteArray & languageKey(int row) const;
+  const QString & directory(int row) const;
+  const QString & coverName(int row) const;
+  const QString & cover(int row) const;
+  QLocale::Language language(int row) const;
+  bool isLilypond(int row) const;
+  uint lastModified(int row) const;
+  qint64 fileSize(int row) const;
+
+  int artistId(int row) const;
+  int albumId(int row) const;
+  int directoryId(int row) const;
+  int coverId(int row) const;
+
+  const CStringPool & artists() const;
+  const CStringPool & albums() const;
+  const CStringPool & directories() const;
+  const CStringPool & covers() const;
+
+  const CTokenIndex & tokenIndex() const;
+  const CTrigramIndex & trigramIndex() const;
+  const CTokenIndex & lyricsIndex() const;
+  uint generation() const;
+
+private:
+  void set(int row, const CLibrary::Song &song);
+  QString makeRelative(const QString &path) const;
+
+  CStringPool m_artists;
+  CStringPool m_albums;
+  CStringPool m_coverNames;
+  CStringPool m_directories;
+  CStringPool m_covers;
+  QVector< int > m_coverNameIds;
+  QVector< QByteArray > m_artistKeys;
+  QVector< QByteArray > m_albumKeys;
+  QHash< int, QByteArray > m_languageKeys;
+
+  QDir m_root;
+  QString m_rootPath;
+
+  CTokenIndex m_tokenIndex;
+  CTrigramIndex m_trigramIndex;
+  CTokenIndex m_lyricsIndex;
+  uint m_generation;
+  bool m_removing;
+  QVector< int > m_remainingRows;
+  int m_rowsBeforeRemove;
+
+  QVector< QString > m_titleColumn;
+  QVector< QByteArray > m_titleKeyColumn;
+  QVector< QString > m_pathColumn;
+  QVector< QByteArray > m_pathKeyColumn;
+  QVector< QString > m_relativePathColumn;
+  QVector< QString > m_searchKeyColumn;
+  QVector< QByteArray > m_lyricsColumn;
+  QVector< int > m_artistColumn;
+  QVector< int > m_albumColumn;
+  QVector< int > m_coverColumn;
+  QVector< int > m_directoryColumn;
+  QVector< QLocale::Language > m_languageColumn;
+  QVector< bool > m_lilypondColumn;
+  QVector< uint > m_lastModifiedColumn;
+  QVector< qint64 > m_sizeColumn;
+};
+
+#endif // __SONG_STORE_HH__
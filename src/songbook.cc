@@ -45,6 +45,7 @@ CSongbook::CSongbook(QObject *parent)
   , m_tmpl()
   , m_selectedSongs()
   , m_songs()
+  , m_unresolvedSongs()
   , m_modified()
   , m_propertyManager(new QtVariantPropertyManager())
   , m_unitManager(new CUnitPropertyManager())
@@ -596,74 +597,108 @@ void CSongbook::load(const QString & filename)
 
 QString CSongbook::workingPath() const
 {
-  return library()->directory().canonicalPath();
+  return library()->canonicalPath();
 }
 
 bool CSongbook::isChecked(const QModelIndex &index)
 {
-  return m_selectedSongs[index.row()];
+  return m_selectedSongs.testBit(index.row());
 }
 
 void CSongbook::setChecked(const QModelIndex &index, bool checked)
 {
-  if (isChecked(index) != checked)
-    {
-      m_selectedSongs[index.row()] = checked;
-      emit(dataChanged(index, index));
-    }
+  if (m_selectedSongs.setBit(index.row(), checked))
+    emit(dataChanged(index, index));
 }
 
 void CSongbook::toggle(const QModelIndex &index)
 {
-  m_selectedSongs[index.row()] = !m_selectedSongs[index.row()];
+  m_selectedSongs.setBit(index.row(), !m_selectedSongs.testBit(index.row()));
   emit(dataChanged(index, index));
 }
 
 void CSongbook::checkAll()
 {
-  for (int i = 0; i < m_selectedSongs.size(); ++i)
-    {
-      m_selectedSongs[i] = true;
-    }
+  if (m_selectedSongs.count() == m_selectedSongs.size())
+    return;
+
+  m_selectedSongs.fill(true);
   emit(dataChanged(index(0,0),index(m_selectedSongs.size()-1,0)));
 }
 
 void CSongbook::uncheckAll()
 {
-  for (int i = 0; i < m_selectedSongs.size(); ++i)
-    {
-      m_selectedSongs[i] = false;
-    }
+  if (m_selectedSongs.count() == 0)
+    return;
+
+  m_selectedSongs.fill(false);
   emit(dataChanged(index(0,0),index(m_selectedSongs.size()-1,0)));
 }
 
 void CSongbook::toggleAll()
 {
-  for (int i = 0; i < m_selectedSongs.size(); ++i)
-    {
-      m_selectedSongs[i] = !m_selectedSongs[i];
-    }
+  if (m_selectedSongs.isEmpty())
+    return;
+
+  m_selectedSongs.invert();
   emit(dataChanged(index(0,0),index(m_selectedSongs.size()-1,0)));
 }
 
 int CSongbook::selectedCount() const
 {
-  int count = 0;
-  for (int i = 0; i < m_selectedSongs.size(); ++i)
+  return m_selectedSongs.count();
+}
+
+void CSongbook::setRowsChecked(const QList< int > &rows, bool checked)
+{
+  QList< int > changed;
+  foreach (int row, rows)
+    {
+      if (m_selectedSongs.setBit(row, checked))
+	changed << row;
+    }
+  notifyRowsChanged(changed);
+}
+
+void CSongbook::toggleRows(const QList< int > &rows)
+{
+  foreach (int row, rows)
+    m_selectedSongs.setBit(row, !m_selectedSongs.testBit(row));
+  notifyRowsChanged(rows);
+}
+
+void CSongbook::notifyRowsChanged(QList< int > rows)
+{
+  // one notification per run of consecutive rows, so that the rows
+  // in between are not filtered again
+  qSort(rows);
+  int i = 0;
+  while (i < rows.size())
     {
-      if (m_selectedSongs[i])
-	count++;
+      int first = rows[i];
+      int last = first;
+      while (++i < rows.size() && rows[i] <= last + 1)
+	last = rows[i];
+      emit(dataChanged(index(first,0),index(last,0)));
     }
-  return count;
 }
 
 void CSongbook::songsFromSelection()
 {
+  // songs missing from the library stay in the songbook, in the order
+  // they had
+  QStringList unresolved;
+  foreach (const QString &path, m_songs)
+    {
+      if (m_unresolvedSongs.contains(path))
+	unresolved << path;
+    }
+
   m_songs.clear();
   QString song;
   for (int i = 0; i < m_selectedSongs.size(); ++i)
     {
-      if (m_selectedSongs[i])
+      if (m_selectedSongs.testBit(i))
 	{
 	  song = data(index(i,0), CLibrary::RelativePathRole).toString();
 #ifdef Q_WS_WIN
@@ -672,6 +707,7 @@ void CSongbook::songsFromSelection()
 	  m_songs << song;
 	}
     }
+  m_songs << unresolved;
 }
 
 void CSongbook::songsToSelection()
@@ -679,23 +715,28 @@ void CSongbook::songsToSelection()
   if (m_songs.isEmpty())
     uncheckAll();
 
-  for (int i = 0; i < m_selectedSongs.size(); ++i)
+  // songs that are not found in the library are kept aside, they are
+  // selected if they show up later on
+  m_unresolvedSongs = m_songs.toSet();
+  m_selectedSongs.fill(false);
+  for (int i = 0; i < m_selectedSongs.size() && !m_unresolvedSongs.isEmpty(); ++i)
     {
-      m_selectedSongs[i] = false;
-      if (m_songs.contains(data(index(i,0), CLibrary::RelativePathRole).toString()))
-	m_selectedSongs[i] = true;
+      if (m_unresolvedSongs.remove(data(index(i,0), CLibrary::RelativePathRole).toString()))
+	m_selectedSongs.setBit(i, true);
     }
   emit(dataChanged(index(0,0),index(m_selectedSongs.size()-1,0)));
 }
 
+QStringList CSongbook::unresolvedSongs() const
+{
+  return m_unresolvedSongs.toList();
+}
+
 void CSongbook::selectLanguages(const QStringList &languages)
 {
+  QSet< QString > selectedLanguages = languages.toSet();
   for (int i = 0; i < m_selectedSongs.size(); ++i)
-    {
-      m_selectedSongs[i] = false;
-      if (languages.contains(data(index(i,0), CLibrary::LanguageRole).toString()))
-	m_selectedSongs[i] = true;
-    }
+    m_selectedSongs.setBit(i, selectedLanguages.contains(data(index(i,0), CLibrary::LanguageRole).toString()));
   emit(dataChanged(index(0,0),index(m_selectedSongs.size()-1,0)));
 }
 
@@ -703,7 +744,7 @@ QVariant CSongbook::data(const QModelIndex &index, int role) const
 {
   if (index.column() == 0 && role == Qt::CheckStateRole)
     {
-      return (m_selectedSongs[index.row()] ? Qt::Checked : Qt::Unchecked);
+      return (m_selectedSongs.testBit(index.row()) ? Qt::Checked : Qt::Unchecked);
     }
   return CIdentityProxyModel::data(index, role);
 }
@@ -719,7 +760,7 @@ bool CSongbook::setData(const QModelIndex &index, const QVariant &value, int rol
 {
   if (index.column() == 0 && role == Qt::CheckStateRole)
     {
-      m_selectedSongs[index.row()] = value.toBool();
+      m_selectedSongs.setBit(index.row(), value.toBool());
       emit(dataChanged(index, index));
       return true;
     }
@@ -735,10 +776,41 @@ void CSongbook::sourceModelAboutToBeReset()
 void CSongbook::sourceModelReset()
 {
   m_selectedSongs.clear();
-  for (int i = 0; i < sourceModel()->rowCount(); ++i)
-    {
-      m_selectedSongs << false;
-    }
+  m_selectedSongs.insert(0, sourceModel()->rowCount());
   songsToSelection();
   endResetModel();
 }
+
+void CSongbook::sourceRowsAboutToBeInserted(const QModelIndex &parent, int start, int end)
+{
+  beginInsertRows(mapFromSource(parent), start, end);
+}
+
+void CSongbook::sourceRowsInserted(const QModelIndex &parent, int start, int end)
+{
+  m_selectedSongs.insert(start, end - start + 1);
+  // songs of the songbook that were missing from the library are
+  // selected again as soon as they show up
+  QList< int > resolved;
+  for (int i = start; i <= end && !m_unresolvedSongs.isEmpty(); ++i)
+    {
+      if (m_unresolvedSongs.remove(sourceModel()->index(i,0).data(CLibrary::RelativePathRole).toString()))
+	{
+	  m_selectedSongs.setBit(i, true);
+	  resolved << i;
+	}
+    }
+  endInsertRows();
+  notifyRowsChanged(resolved);
+}
+
+void CSongbook::sourceRowsAboutToBeRemoved(const QModelIndex &parent, int start, int end)
+{
+  beginRemoveRows(mapFromSource(parent), start, end);
+}
+
+void CSongbook::sourceRowsRemoved(const QModelIndex &parent, int start, int end)
+{
+  m_selectedSongs.remove(start, end - start + 1);
+  endRemoveRows();
+}
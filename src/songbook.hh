@@ -20,10 +20,12 @@
 #define __SONGBOOK_HH__
 
 #include "identity-proxy-model.hh"
+#include "song-selection.hh"
 
 #include <QDir>
 #include <QString>
 #include <QStringList>
+#include <QSet>
 
 #include <QtVariantProperty>
 
@@ -78,10 +80,13 @@ public:
   QString tmpl() const;
 
   int selectedCount() const;
+  void setRowsChecked(const QList< int > &rows, bool checked);
+  void toggleRows(const QList< int > &rows);
   void selectLanguages(const QStringList &languages);
 
   void songsFromSelection();
   void songsToSelection();
+  QStringList unresolvedSongs() const;
 
   QStringList songs();
 
@@ -102,14 +107,21 @@ signals:
 private slots:
   void sourceModelAboutToBeReset();
   void sourceModelReset();
+  void sourceRowsAboutToBeInserted(const QModelIndex &parent, int start, int end);
+  void sourceRowsInserted(const QModelIndex &parent, int start, int end);
+  void sourceRowsAboutToBeRemoved(const QModelIndex &parent, int start, int end);
+  void sourceRowsRemoved(const QModelIndex &parent, int start, int end);
 
 private:
+  void notifyRowsChanged(QList< int > rows);
+
   CLibrary *m_library;
   QString m_filename;
   QString m_tmpl;
 
-  QList< bool > m_selectedSongs;
+  CSongSelection m_selectedSongs;
   QStringList m_songs;
+  QSet< QString > m_unresolvedSongs;
 
   bool m_modified;
 
@@ -0,0 +1,60 @@
+// Copyright (C) 2009-2011, Romain Goffe <romain.goffe@gmail.com>
+// Copyright (C) 2009-2011, Alexandre Dupas <alexandre.dupas@gmail.com>
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License as
+// published by the Free Software Foundation; either version 2 of the
+// License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+// 02110-1301, USA.
+//******************************************************************************
+#include "string-pool.hh"
+
+CStringPool::CStringPool()
+  : m_strings()
+  , m_ids()
+{}
+
+CStringPool::~CStringPool()
+{}
+
+int CStringPool::intern(const QString &str)
+{
+  QHash< QString, int >::const_iterator it = m_ids.constFind(str);
+  if (it != m_ids.constEnd())
+    return *it;
+
+  int id = m_strings.size();
+  m_strings << str;
+  m_ids.insert(str, id);
+  return id;
+}
+
+const QString & CStringPool::at(int id) const
+{
+  return m_strings[id];
+}
+
+int CStringPool::indexOf(const QString &str) const
+{
+  return m_ids.value(str, -1);
+}
+
+int CStringPool::size() const
+{
+  return m_strings.size();
+}
+
+void CStringPool::clear()
+{
+  m_strings.clear();
+  m_ids.clear();
+}
@@ -0,0 +1,295 @@
+// Copyright (C) 2009-2011, Romain Goffe <romain.goffe@gmail.com>
+// Copyright (C) 2009-2011, Alexandre Dupas <alexandre.dupas@gmail.com>
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License as
+// published by the Free Software Foundation; either version 2 of the
+// License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+// 02110-1301, USA.
+//******************************************************************************
+#include "token-index.hh"
+
+#include <QtAlgorithms>
+
+CTokenIndex::CTokenIndex()
+  : m_tokens()
+  , m_postings()
+  , m_tokenGrams()
+{}
+
+CTokenIndex::~CTokenIndex()
+{}
+
+void CTokenIndex::insert(int row, const QString &key)
+{
+  foreach (const QString &token, tokenize(key))
+    {
+      int id = m_tokens.intern(token);
+      if (id == m_postings.size())
+	{
+	  // identifiers grow, which keeps the lists sorted
+	  m_postings.resize(id + 1);
+	  for (int size = 1; size <= 3; ++size)
+	    {
+	      foreach (quint64 gram, grams(token, size))
+		m_tokenGrams[gram] << id;
+	    }
+	}
+
+      // rows are mostly appended, which keeps the lists sorted for free
+      QVector< int > &postings = m_postings[id];
+      if (postings.isEmpty() || postings.last() < row)
+	postings << row;
+      else
+	{
+	  QVector< int >::iterator it = qLowerBound(postings.begin(), postings.end(), row);
+	  if (*it != row)
+	    postings.insert(it, row);
+	}
+    }
+}
+
+void CTokenIndex::remove(int row, const QString &key)
+{
+  foreach (const QString &token, tokenize(key))
+    {
+      int id = m_tokens.indexOf(token);
+      if (id == -1)
+	continue;
+
+      QVector< int > &postings = m_postings[id];
+      QVector< int >::iterator it = qBinaryFind(postings.begin(), postings.end(), row);
+      if (it != postings.end())
+	postings.erase(it);
+    }
+}
+
+void CTokenIndex::renumberRows(const QVector< int > &rows)
+{
+  // the new numbers keep the order of the rows, the posting lists stay
+  // sorted
+  for (int i = 0; i < m_postings.size(); ++i)
+    {
+      QVector< int > &postings = m_postings[i];
+      int size = 0;
+      for (int j = 0; j < postings.size(); ++j)
+	{
+	  if (rows[postings[j]] != -1)
+	    postings[size++] = rows[postings[j]];
+	}
+      postings.resize(size);
+    }
+}
+
+void CTokenIndex::clear()
+{
+  m_tokens.clear();
+  m_postings.clear();
+  m_tokenGrams.clear();
+}
+
+QVector< int > CTokenIndex::rows(const QString &keyword) const
+{
+  QVector< int > tokens;
+  foreach (int i, candidates(keyword))
+    {
+      if (m_tokens.at(i).contains(keyword))
+	tokens << i;
+    }
+  return merge(tokens);
+}
+
+QVector< int > CTokenIndex::approximateRows(const QString &keyword) const
+{
+  if (keyword.size() < 3)
+    return rows(keyword);
+
+  // a word within the edit distance of the keyword shares most of its
+  // bigrams, a single edit breaking at most three of them
+  int maxDistance = keyword.size() < 5 ? 1 : 2;
+  QVector< quint64 > keywordBigrams = grams(keyword, 2);
+  QHash< int, int > shared;
+  foreach (quint64 bigram, keywordBigrams)
+    {
+      foreach (int i, m_tokenGrams.value(bigram))
+	++shared[i];
+    }
+
+  // words are compared as a whole, or by their beginning when the
+  // keyword is still being typed
+  QVector< int > tokens;
+  int required = keywordBigrams.size() - 3 * maxDistance;
+  QHash< int, int >::const_iterator it;
+  for (it = shared.constBegin(); it != shared.constEnd(); ++it)
+    {
+      const QString &token = m_tokens.at(it.key());
+      if (it.value() >= required
+	  && (token.contains(keyword)
+	      || distance(keyword, token) <= maxDistance
+	      || distance(keyword, token.left(keyword.size())) <= maxDistance))
+	tokens << it.key();
+    }
+  return merge(tokens);
+}
+
+QVector< int > CTokenIndex::merge(const QVector< int > &tokens) const
+{
+  QVector< int > result;
+  int matches = 0;
+  int lastRow = -1;
+  foreach (int i, tokens)
+    {
+      if (m_postings[i].isEmpty())
+	continue;
+
+      result << m_postings[i];
+      lastRow = qMax(lastRow, m_postings[i].last());
+      ++matches;
+    }
+
+  // a single word already gives a sorted list without duplicates; the
+  // many words sharing a short keyword are merged by marking their rows
+  // rather than by sorting them
+  if (matches > 1 && result.size() > lastRow / 4)
+    {
+      QVector< bool > marked(lastRow + 1, false);
+      foreach (int row, result)
+	marked[row] = true;
+      result.clear();
+      for (int row = 0; row <= lastRow; ++row)
+	{
+	  if (marked[row])
+	    result << row;
+	}
+    }
+  else if (matches > 1)
+    {
+      sortUnique(result);
+    }
+  return result;
+}
+
+int CTokenIndex::distance(const QString &a, const QString &b)
+{
+  // edit distance where swapping two adjacent characters counts as a
+  // single edit, on three rolling rows
+  QVector< int > previous(b.size() + 1);
+  QVector< int > current(b.size() + 1);
+  QVector< int > next(b.size() + 1);
+  for (int j = 0; j <= b.size(); ++j)
+    current[j] = j;
+
+  for (int i = 1; i <= a.size(); ++i)
+    {
+      next[0] = i;
+      for (int j = 1; j <= b.size(); ++j)
+	{
+	  int cost = a[i - 1] == b[j - 1] ? 0 : 1;
+	  next[j] = qMin(qMin(current[j] + 1, next[j - 1] + 1), current[j - 1] + cost);
+	  if (i > 1 && j > 1 && a[i - 1] == b[j - 2] && a[i - 2] == b[j - 1])
+	    next[j] = qMin(next[j], previous[j - 2] + 1);
+	}
+      qSwap(previous, current);
+      qSwap(current, next);
+    }
+  return current[b.size()];
+}
+
+QVector< int > CTokenIndex::candidates(const QString &keyword) const
+{
+  // words containing a keyword shorter than a trigram are indexed by
+  // the keyword itself
+  if (keyword.size() < 3)
+    return keyword.isEmpty() ? QVector< int >() : m_tokenGrams.value(gram(keyword.constData(), keyword.size()));
+
+  // the words containing the keyword contain all of its trigrams,
+  // starting from the rarest trigram keeps the intersections short
+  QList< QVector< int > > lists;
+  foreach (quint64 trigram, grams(keyword, 3))
+    {
+      QHash< quint64, QVector< int > >::const_iterator it = m_tokenGrams.constFind(trigram);
+      if (it == m_tokenGrams.constEnd())
+	return QVector< int >();
+      lists << *it;
+    }
+
+  int smallest = 0;
+  for (int i = 1; i < lists.size(); ++i)
+    {
+      if (lists[i].size() < lists[smallest].size())
+	smallest = i;
+    }
+  QVector< int > tokens = lists.takeAt(smallest);
+  foreach (const QVector< int > &other, lists)
+    tokens = intersect(tokens, other);
+  return tokens;
+}
+
+quint64 CTokenIndex::gram(const QChar *chars, int size)
+{
+  // characters are never null, grams of different sizes never collide
+  quint64 result = 0;
+  for (int i = 0; i < size; ++i)
+    result = (result << 16) | chars[i].unicode();
+  return result;
+}
+
+QVector< quint64 > CTokenIndex::grams(const QString &word, int size)
+{
+  QVector< quint64 > result;
+  for (int i = 0; i + size <= word.size(); ++i)
+    result << gram(word.constData() + i, size);
+  sortUnique(result);
+  return result;
+}
+
+QVector< int > CTokenIndex::intersect(const QVector< int > &a, const QVector< int > &b)
+{
+  QVector< int > result;
+  QVector< int >::const_iterator i = a.constBegin();
+  QVector< int >::const_iterator j = b.constBegin();
+  while (i != a.constEnd() && j != b.constEnd())
+    {
+      if (*i < *j)
+	++i;
+      else if (*j < *i)
+	++j;
+      else
+	{
+	  result << *i;
+	  ++i;
+	  ++j;
+	}
+    }
+  return result;
+}
+
+QStringList CTokenIndex::tokenize(const QString &key)
+{
+  QStringList tokens;
+  int begin = -1;
+  for (int i = 0; i <= key.size(); ++i)
+    {
+      if (i == key.size() || key[i].isSpace())
+	{
+	  if (begin != -1)
+	    tokens << key.mid(begin, i - begin);
+	  begin = -1;
+	}
+      else if (begin == -1)
+	{
+	  begin = i;
+	}
+    }
+  tokens.removeDuplicates();
+  return tokens;
+}
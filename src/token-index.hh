@@ -0,0 +1,99 @@
+// Copyright (C) 2009-2011, Romain Goffe <romain.goffe@gmail.com>
+// Copyright (C) 2009-2011, Alexandre Dupas <alexandre.dupas@gmail.com>
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License as
+// published by the Free Software Foundation; either version 2 of the
+// License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+// 02110-1301, USA.
+//******************************************************************************
+
+/**
+ * \file token-index.hh
+ *
+ * Inverted index of the words of the library.
+ *
+ */
+#ifndef __TOKEN_INDEX_HH__
+#define __TOKEN_INDEX_HH__
+
+#include <QString>
+#include <QStringList>
+#include <QVector>
+#include <QHash>
+#include <QtAlgorithms>
+
+#include "string-pool.hh"
+
+/**
+ * \class CTokenIndex
+ *
+ * Maps each word of the search keys to the sorted list of the rows it
+ * appears in.
+ *
+ * Words are delimited by white spaces only, so that a keyword without
+ * spaces is contained in a search key if and only if it is contained
+ * in one of its words. The words of the vocabulary are themselves
+ * indexed by their trigrams: looking a keyword up only checks the
+ * words that contain all the trigrams of the keyword, then merges
+ * their posting lists. The words are also indexed by their one and
+ * two character substrings, which gives the words matching a shorter
+ * keyword directly.
+ *
+ * approximateRows() also accepts the words within one or two edits of
+ * the keyword, found among the words sharing most of its bigrams.
+ */
+class CTokenIndex
+{
+public:
+  CTokenIndex();
+  ~CTokenIndex();
+
+  void insert(int row, const QString &key);
+  void remove(int row, const QString &key);
+  void renumberRows(const QVector< int > &rows);
+  void clear();
+
+  QVector< int > rows(const QString &keyword) const;
+  QVector< int > approximateRows(const QString &keyword) const;
+
+  static QVector< int > intersect(const QVector< int > &a, const QVector< int > &b);
+  static QStringList tokenize(const QString &key);
+
+  static quint64 gram(const QChar *chars, int size);
+  static QVector< quint64 > grams(const QString &word, int size);
+  template< typename T > static void sortUnique(QVector< T > &values);
+
+private:
+  QVector< int > candidates(const QString &keyword) const;
+  QVector< int > merge(const QVector< int > &tokens) const;
+  static int distance(const QString &a, const QString &b);
+
+  CStringPool m_tokens;
+  QVector< QVector< int > > m_postings;
+  QHash< quint64, QVector< int > > m_tokenGrams;
+};
+
+template< typename T >
+void CTokenIndex::sortUnique(QVector< T > &values)
+{
+  qSort(values);
+  typename QVector< T >::iterator end = values.begin();
+  for (typename QVector< T >::const_iterator it = values.constBegin(); it != values.constEnd(); ++it)
+    {
+      if (end == values.begin() || *(end - 1) != *it)
+	*end++ = *it;
+    }
+  values.erase(end, values.end());
+}
+
+#endif // __TOKEN_INDEX_HH__
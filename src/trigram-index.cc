@@ -0,0 +1,112 @@
+// Copyright (C) 2009-2011, Romain Goffe <romain.goffe@gmail.com>
+// Copyright (C) 2009-2011, Alexandre Dupas <alexandre.dupas@gmail.com>
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License as
+// published by the Free Software Foundation; either version 2 of the
+// License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+// 02110-1301, USA.
+//******************************************************************************
+#include "trigram-index.hh"
+
+#include <QtAlgorithms>
+
+#include "token-index.hh"
+
+CTrigramIndex::CTrigramIndex()
+  : m_postings()
+{}
+
+CTrigramIndex::~CTrigramIndex()
+{}
+
+void CTrigramIndex::insert(int row, const QString &key)
+{
+  foreach (quint64 trigram, trigrams(key))
+    {
+      // rows are mostly appended, which keeps the lists sorted for free
+      QVector< int > &postings = m_postings[trigram];
+      if (postings.isEmpty() || postings.last() < row)
+	postings << row;
+      else
+	{
+	  QVector< int >::iterator it = qLowerBound(postings.begin(), postings.end(), row);
+	  if (*it != row)
+	    postings.insert(it, row);
+	}
+    }
+}
+
+void CTrigramIndex::remove(int row, const QString &key)
+{
+  foreach (quint64 trigram, trigrams(key))
+    {
+      QHash< quint64, QVector< int > >::iterator postings = m_postings.find(trigram);
+      if (postings == m_postings.end())
+	continue;
+
+      QVector< int >::iterator it = qBinaryFind(postings->begin(), postings->end(), row);
+      if (it != postings->end())
+	postings->erase(it);
+    }
+}
+
+void CTrigramIndex::renumberRows(const QVector< int > &rows)
+{
+  // the new numbers keep the order of the rows, the posting lists stay
+  // sorted
+  QHash< quint64, QVector< int > >::iterator postings;
+  for (postings = m_postings.begin(); postings != m_postings.end(); ++postings)
+    {
+      int size = 0;
+      for (int j = 0; j < postings->size(); ++j)
+	{
+	  int row = rows[postings->at(j)];
+	  if (row != -1)
+	    (*postings)[size++] = row;
+	}
+      postings->resize(size);
+    }
+}
+
+void CTrigramIndex::clear()
+{
+  m_postings.clear();
+}
+
+QVector< int > CTrigramIndex::count(const QVector< quint64 > &trigrams, int size) const
+{
+  // number of the given trigrams found in each row
+  QVector< int > counts(size, 0);
+  foreach (quint64 trigram, trigrams)
+    {
+      QHash< quint64, QVector< int > >::const_iterator postings = m_postings.constFind(trigram);
+      if (postings == m_postings.constEnd())
+	continue;
+
+      foreach (int row, *postings)
+	{
+	  if (row < size)
+	    ++counts[row];
+	}
+    }
+  return counts;
+}
+
+QVector< quint64 > CTrigramIndex::trigrams(const QString &text)
+{
+  QVector< quint64 > result;
+  foreach (const QString &token, CTokenIndex::tokenize(text))
+    result << CTokenIndex::grams(QChar(' ') + token + QChar(' '), 3);
+  CTokenIndex::sortUnique(result);
+  return result;
+}
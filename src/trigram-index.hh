@@ -0,0 +1,62 @@
+// Copyright (C) 2009-2011, Romain Goffe <romain.goffe@gmail.com>
+// Copyright (C) 2009-2011, Alexandre Dupas <alexandre.dupas@gmail.com>
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License as
+// published by the Free Software Foundation; either version 2 of the
+// License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+// 02110-1301, USA.
+//******************************************************************************
+
+/**
+ * \file trigram-index.hh
+ *
+ * Trigram index of the words of the library.
+ *
+ */
+#ifndef __TRIGRAM_INDEX_HH__
+#define __TRIGRAM_INDEX_HH__
+
+#include <QString>
+#include <QVector>
+#include <QHash>
+
+/**
+ * \class CTrigramIndex
+ *
+ * Maps the trigrams of the search keys to the sorted list of the rows
+ * they appear in, which measures how close a row is to a keyword.
+ *
+ * Each word is padded with a space on both sides before being cut
+ * into trigrams, so that the beginning and the end of the words weigh
+ * in the similarity.
+ */
+class CTrigramIndex
+{
+public:
+  CTrigramIndex();
+  ~CTrigramIndex();
+
+  void insert(int row, const QString &key);
+  void remove(int row, const QString &key);
+  void renumberRows(const QVector< int > &rows);
+  void clear();
+
+  QVector< int > count(const QVector< quint64 > &trigrams, int size) const;
+
+  static QVector< quint64 > trigrams(const QString &text);
+
+private:
+  QHash< quint64, QVector< int > > m_postings;
+};
+
+#endif // __TRIGRAM_INDEX_HH__
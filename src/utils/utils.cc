@@ -22,6 +22,8 @@
 #include <QMessageBox>
 #include <QDebug>
 
+#include <cstring>
+
 #include "utils.hh"
 
 namespace SbUtils
@@ -54,6 +56,45 @@ namespace SbUtils
     return str;
   }
   //------------------------------------------------------------------------------
+  QString foldString(const QString & AString)
+  {
+    // decompose the accented letters and drop their diacritics
+    QString decomposed = AString.normalized(QString::NormalizationForm_D);
+    QString str;
+    str.reserve(decomposed.size());
+    for (int i = 0; i < decomposed.size(); ++i)
+      {
+	if (decomposed[i].category() != QChar::Mark_NonSpacing)
+	  str.append(decomposed[i]);
+      }
+    return str.toCaseFolded();
+  }
+  //------------------------------------------------------------------------------
+  QByteArray collationKey(const QString & AString)
+  {
+    // the folded string is transformed with the collation of the
+    // current locale so that keys only need a plain comparison; on
+    // Unix this is how Qt 4 implements QString::localeAwareCompare().
+    // Strings that the locale encoding cannot represent keep their
+    // folded UTF-8 bytes rather than colliding on replaced characters.
+    // The two kinds of keys do not compare meaningfully with each
+    // other, so a leading byte sorts each kind among itself.
+    QString folded = foldString(AString);
+    QByteArray str = folded.toLocal8Bit();
+    if (QString::fromLocal8Bit(str) != folded)
+      return QByteArray(1, '\x02') + folded.toUtf8();
+
+    size_t size = strxfrm(0, str.constData(), 0);
+    if (size == size_t(-1))
+      return QByteArray(1, '\x02') + folded.toUtf8();
+
+    QByteArray key(int(size) + 2, '\0');
+    key[0] = '\x01';
+    strxfrm(key.data() + 1, str.constData(), size + 1);
+    key.resize(int(size) + 1);
+    return key;
+  }
+  //------------------------------------------------------------------------------
   QString filenameToString(const QString AString)
   {
     QString str(AString);
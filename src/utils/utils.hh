@@ -28,6 +28,8 @@ enum SbPriority { LowPriority, MediumPriority, HighPriority };
 namespace SbUtils
 {
   QString latexToUtf8(const QString & str);
+  QString foldString(const QString & str);
+  QByteArray collationKey(const QString & str);
   QString filenameToString(const QString & str);
   QString stringToFilename(const QString & str, const QString & sep);
   bool copyFile(const QString & ASourcePath, const QString & ATargetDirectory);